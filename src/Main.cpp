@@ -1,20 +1,42 @@
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QSettings>
 #include <QStyle>
+#include <QTextStream>
 
 #include "config/Config.h"
 #include "config/Options.h"
+#include "debug/MemoryReport.h"
 #include "Window.h"
 
 int main(int argc, char** argv) {
+    // Has to be checked before the application exists, so the report can run without a display
+    const bool headless = std::any_of(argv + 1, argv + argc, [](const char* arg) {
+        return std::strcmp(arg, "--memory-report") == 0;
+    });
+    if (headless && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication app(argc, argv);
 
     QCoreApplication::setOrganizationName(ENTGRAPH_PROJECT_ORGANIZATION_NAME);
     QCoreApplication::setApplicationName(ENTGRAPH_PROJECT_NAME);
     QCoreApplication::setApplicationVersion(ENTGRAPH_PROJECT_VERSION);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("map", QCoreApplication::translate("main", "VMF or BSP to open."), "[map]");
+    QCommandLineOption memoryReportOption("memory-report", QCoreApplication::translate("main", "Load the map, print how much memory each part of it uses, and exit."));
+    parser.addOption(memoryReportOption);
+    parser.process(app);
+    const auto positionalArguments = parser.positionalArguments();
+
 #if !defined(__APPLE__) && !defined(_WIN32)
     QGuiApplication::setDesktopFileName(ENTGRAPH_PROJECT_NAME);
 #endif
@@ -29,7 +51,22 @@ int main(int argc, char** argv) {
     Options::setupOptions(*options);
 
     auto* window = new Window();
+
+    if (parser.isSet(memoryReportOption)) {
+        window->setMeasureLoadMemory(true);
+        if (positionalArguments.isEmpty() || !window->openPath(positionalArguments.first())) {
+            QTextStream(stderr) << QCoreApplication::translate("main", "Failed to load a map to report on!") << '\n';
+            return 1;
+        }
+        QTextStream(stdout) << window->memoryReport().toText();
+        delete window;
+        return 0;
+    }
+
     window->show();
+    if (!positionalArguments.isEmpty()) {
+        window->openPath(positionalArguments.first());
+    }
 
     return QApplication::exec();
 }
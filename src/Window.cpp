@@ -1,26 +1,50 @@
 #include "Window.h"
 
+#include <future>
+
 #include <QActionGroup>
 #include <QApplication>
 #include <QCloseEvent>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QSettings>
+#include <QStatusBar>
 #include <QStyle>
 #include <QStyleFactory>
 
 #include "config/Config.h"
 #include "config/Options.h"
+#include "debug/MemoryReport.h"
+#include "debug/MemoryReportDialog.h"
+#include "debug/Trace.h"
+#include "fgd/FGDCache.h"
+#include "graph/EntityDiagnosticsPanel.h"
 #include "graph/EntityGraph.h"
+#include "graph/EntityGraphDiff.h"
+#include "graph/EntityValidator.h"
+#include "index/MapIndexer.h"
+#include "index/MapSearchDialog.h"
+#include "wrapper/BSPWrapper.h"
 #include "wrapper/VMFWrapper.h"
 
+constexpr auto VMF_OPEN_FILTER = "Valve Map Format (*.vmf);;Compiled Map (*.bsp);;All files (*.*)";
 constexpr auto VMF_SAVE_FILTER = "Valve Map Format (*.vmf);;All files (*.*)";
+constexpr auto DOT_SAVE_FILTER = "Graphviz DOT (*.dot *.gv);;All files (*.*)";
+constexpr auto GRAPHML_SAVE_FILTER = "GraphML (*.graphml);;All files (*.*)";
+constexpr auto NDJSON_SAVE_FILTER = "Newline-delimited JSON (*.ndjson *.jsonl);;All files (*.*)";
+constexpr auto FGD_OPEN_FILTER = "Forge Game Data (*.fgd);;All files (*.*)";
+#if ENTGRAPH_ENABLE_TRACING
+constexpr auto TRACE_SAVE_FILTER = "Chrome Trace (*.json);;All files (*.*)";
+#endif
 
 Window::Window(QWidget* parent)
 		: QMainWindow(parent)
-		, modified(false) {
+		, modified(false)
+		, measureLoadMemory(Options::get<bool>(OPT_MEASURE_LOAD_MEMORY)) {
 	this->setWindowIcon(QIcon(":/icon.png"));
 	this->setMinimumSize(900, 500);
 
@@ -30,12 +54,25 @@ Window::Window(QWidget* parent)
 	this->openAction = fileMenu->addAction(this->style()->standardIcon(QStyle::SP_DirIcon), tr("&Open..."), Qt::CTRL | Qt::Key_O, [&] {
 		this->open();
 	});
+	fileMenu->addAction(this->style()->standardIcon(QStyle::SP_FileDialogDetailedView), tr("Co&mpare Revisions..."), Qt::CTRL | Qt::Key_D, [&] {
+		this->compareRevisions();
+	});
 	this->saveAction = fileMenu->addAction(this->style()->standardIcon(QStyle::SP_DialogSaveButton), tr("&Save"), Qt::CTRL | Qt::Key_S, [&] {
 		this->save();
 	});
 	this->saveAsAction = fileMenu->addAction(this->style()->standardIcon(QStyle::SP_DialogSaveButton), tr("Save &As..."), Qt::CTRL | Qt::SHIFT | Qt::Key_S, [&] {
 		this->saveAs();
 	});
+	this->exportMenu = fileMenu->addMenu(this->style()->standardIcon(QStyle::SP_DialogSaveButton), tr("&Export"));
+	this->exportMenu->addAction(tr("Graphviz &DOT..."), [&] {
+		this->exportGraph(EntityGraphExporter::FORMAT_DOT);
+	});
+	this->exportMenu->addAction(tr("&GraphML..."), [&] {
+		this->exportGraph(EntityGraphExporter::FORMAT_GRAPHML);
+	});
+	this->exportMenu->addAction(tr("Newline-Delimited &JSON..."), [&] {
+		this->exportGraph(EntityGraphExporter::FORMAT_NDJSON);
+	});
 	this->closeFileAction = fileMenu->addAction(this->style()->standardIcon(QStyle::SP_BrowserReload), tr("&Close"), Qt::CTRL | Qt::Key_X, [&] {
 		this->closeFile();
 	});
@@ -49,6 +86,10 @@ Window::Window(QWidget* parent)
 	// Options menu
 	auto* optionsMenu = this->menuBar()->addMenu(tr("&Options"));
 
+	optionsMenu->addAction(this->style()->standardIcon(QStyle::SP_FileIcon), tr("Set &FGD..."), [&] {
+		this->chooseFGD();
+	});
+
 	auto* themeMenu = optionsMenu->addMenu(this->style()->standardIcon(QStyle::SP_DesktopIcon), tr("&Theme..."));
 	auto* themeMenuGroup = new QActionGroup(this);
 	themeMenuGroup->setExclusive(true);
@@ -64,8 +105,65 @@ Window::Window(QWidget* parent)
 		themeMenuGroup->addAction(action);
 	}
 
+	this->diagnostics = new EntityDiagnosticsPanel(this);
+	this->addDockWidget(Qt::BottomDockWidgetArea, this->diagnostics);
+	QObject::connect(this->diagnostics, &EntityDiagnosticsPanel::entityActivated, this, [this](int entityId) {
+		this->graph->centerOnNode(entityId);
+	});
+
+	// View menu
+	auto* viewMenu = this->menuBar()->addMenu(tr("&View"));
+	auto* showMinimapAction = viewMenu->addAction(tr("Show &Minimap"), Qt::CTRL | Qt::Key_M, [&] {
+		Options::invert(OPT_SHOW_MINIMAP);
+		this->graph->setMinimapVisible(Options::get<bool>(OPT_SHOW_MINIMAP));
+	});
+	showMinimapAction->setCheckable(true);
+	showMinimapAction->setChecked(Options::get<bool>(OPT_SHOW_MINIMAP));
+	auto* bundleConnectionsAction = viewMenu->addAction(tr("&Bundle Connections"), Qt::CTRL | Qt::Key_B, [&] {
+		Options::invert(OPT_BUNDLE_CONNECTIONS);
+		this->graph->setConnectionBundling(Options::get<bool>(OPT_BUNDLE_CONNECTIONS));
+	});
+	bundleConnectionsAction->setCheckable(true);
+	bundleConnectionsAction->setChecked(Options::get<bool>(OPT_BUNDLE_CONNECTIONS));
+	auto* showDiagnosticsAction = this->diagnostics->toggleViewAction();
+	showDiagnosticsAction->setText(tr("Show &Diagnostics"));
+	showDiagnosticsAction->setShortcut(Qt::CTRL | Qt::Key_E);
+	viewMenu->addAction(showDiagnosticsAction);
+#if ENTGRAPH_ENABLE_TRACING
+	viewMenu->addSeparator();
+	auto* showFrameStatsAction = viewMenu->addAction(tr("Show &Frame Stats"), Qt::Key_F3, [&](bool checked) {
+		this->graph->setFrameStatsVisible(checked);
+	});
+	showFrameStatsAction->setCheckable(true);
+#endif
+
+	// Tools menu
+	auto* toolsMenu = this->menuBar()->addMenu(tr("&Tools"));
+	toolsMenu->addAction(this->style()->standardIcon(QStyle::SP_FileDialogContentsView), tr("Search Installed &Maps..."), Qt::CTRL | Qt::SHIFT | Qt::Key_F, [&] {
+		this->searchInstalledMaps();
+	});
+#if ENTGRAPH_ENABLE_TRACING
+	toolsMenu->addSeparator();
+	toolsMenu->addAction(this->style()->standardIcon(QStyle::SP_DialogSaveButton), tr("Export &Trace..."), [&] {
+		this->exportTrace();
+	});
+	toolsMenu->addAction(this->style()->standardIcon(QStyle::SP_DialogResetButton), tr("&Clear Trace"), [&] {
+		Trace::clear();
+	});
+#endif
+
 	// Help menu
 	auto* helpMenu = this->menuBar()->addMenu(tr("&Help"));
+	helpMenu->addAction(this->style()->standardIcon(QStyle::SP_ComputerIcon), tr("&Memory Report..."), [&] {
+		this->showMemoryReport();
+	});
+	auto* measureLoadMemoryAction = helpMenu->addAction(tr("Measure Memory While &Loading"), [&] {
+		Options::invert(OPT_MEASURE_LOAD_MEMORY);
+		this->setMeasureLoadMemory(Options::get<bool>(OPT_MEASURE_LOAD_MEMORY));
+	});
+	measureLoadMemoryAction->setCheckable(true);
+	measureLoadMemoryAction->setChecked(Options::get<bool>(OPT_MEASURE_LOAD_MEMORY));
+	helpMenu->addSeparator();
 	helpMenu->addAction(this->style()->standardIcon(QStyle::SP_DialogHelpButton), tr("&About"), Qt::Key_F1, [&] {
 		this->about();
 	});
@@ -73,22 +171,67 @@ Window::Window(QWidget* parent)
 		this->aboutQt();
 	});
 
+	this->mapIndexer = new MapIndexer(Options::getCacheDirectory() + "/mapindex.bin", this);
+
 	this->graph = new EntityGraph(this);
+	this->graph->setMinimapVisible(Options::get<bool>(OPT_SHOW_MINIMAP));
+	this->graph->setConnectionBundling(Options::get<bool>(OPT_BUNDLE_CONNECTIONS));
 	this->setCentralWidget(this->graph);
 
 	// Finalize window
 	this->clearContents();
 }
 
+Window::~Window() = default;
+
 void Window::open(const QString& startPath) {
-	auto path = QFileDialog::getOpenFileName(this, tr("Open VMF"), startPath, VMF_SAVE_FILTER);
+	auto path = QFileDialog::getOpenFileName(this, tr("Open Map"), startPath, VMF_OPEN_FILTER);
 	if (path.isEmpty()) {
 		return;
 	}
-	if (!this->load(path)) {
+	this->openPath(path);
+}
+
+void Window::compareRevisions() {
+	const auto oldPath = QFileDialog::getOpenFileName(this, tr("Open Older Revision"), QString(), VMF_OPEN_FILTER);
+	if (oldPath.isEmpty()) {
+		return;
+	}
+	const auto newPath = QFileDialog::getOpenFileName(this, tr("Open Newer Revision"), QFileInfo(oldPath).absolutePath(), VMF_OPEN_FILTER);
+	if (newPath.isEmpty()) {
+		return;
+	}
+
+	this->clearContents();
+	this->freezeActions(true);
+
+	// The revisions only share the instance cache, so parse them at the same time
+	auto oldEntities = std::async(std::launch::async, [this, &oldPath] {
+		return this->readEntities(oldPath);
+	});
+	const auto newEntities = this->readEntities(newPath);
+	const auto oldEntitiesResult = oldEntities.get();
+	if (!oldEntitiesResult || !newEntities) {
+		QMessageBox::warning(this, tr("Error"), tr("Failed to parse \"%1\"!").arg(!oldEntitiesResult ? oldPath : newPath));
 		this->clearContents();
+		this->graph->setDisabled(false);
+		return;
+	}
+
+	const EntityGraphDiff diff{*oldEntitiesResult, *newEntities};
+	if (!this->fgd) {
+		this->loadFGD();
 	}
+	this->graph->showDiff(diff, this->fgd.get());
+
+	this->freezeActions(false);
 	this->graph->setDisabled(false);
+	this->statusBar()->showMessage(tr("%1 added, %2 removed, %3 changed entities. %4 added, %5 removed connections.")
+		.arg(diff.count(EntityGraphDiff::STATE_ADDED))
+		.arg(diff.count(EntityGraphDiff::STATE_REMOVED))
+		.arg(diff.count(EntityGraphDiff::STATE_CHANGED))
+		.arg(diff.connectionCount(EntityGraphDiff::STATE_ADDED))
+		.arg(diff.connectionCount(EntityGraphDiff::STATE_REMOVED)));
 }
 
 void Window::save() {
@@ -105,6 +248,89 @@ void Window::closeFile() {
 	this->clearContents();
 }
 
+void Window::exportGraph(EntityGraphExporter::Format format) {
+	const char* filter = nullptr;
+	switch (format) {
+		case EntityGraphExporter::FORMAT_DOT:
+			filter = DOT_SAVE_FILTER;
+			break;
+		case EntityGraphExporter::FORMAT_GRAPHML:
+			filter = GRAPHML_SAVE_FILTER;
+			break;
+		case EntityGraphExporter::FORMAT_NDJSON:
+			filter = NDJSON_SAVE_FILTER;
+			break;
+	}
+	auto path = QFileDialog::getSaveFileName(this, tr("Export"), QString(), filter);
+	if (path.isEmpty()) {
+		return;
+	}
+	if (!EntityGraphExporter{this->graph->model()}.exportToFile(path, format)) {
+		QMessageBox::warning(this, tr("Error"), tr("Failed to export the graph to \"%1\"!").arg(path));
+	}
+}
+
+void Window::chooseFGD() {
+	auto path = QFileDialog::getOpenFileName(this, tr("Set FGD"), Options::get<QString>(OPT_FGD_PATH), FGD_OPEN_FILTER);
+	if (path.isEmpty()) {
+		return;
+	}
+	Options::set(OPT_FGD_PATH, path);
+	if (!this->loadFGD()) {
+		QMessageBox::warning(this, tr("Error"), tr("Failed to parse the FGD at \"%1\"! Entity inputs will not be available.").arg(path));
+	}
+}
+
+void Window::searchInstalledMaps() {
+	this->mapIndexer->start();
+
+	auto* dialog = new MapSearchDialog(this->mapIndexer, this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	QObject::connect(dialog, &MapSearchDialog::mapActivated, this, [this](const QString& path) {
+		this->openPath(path);
+	});
+	dialog->show();
+}
+
+#if ENTGRAPH_ENABLE_TRACING
+void Window::exportTrace() {
+	auto path = QFileDialog::getSaveFileName(this, tr("Export Trace"), QString(), TRACE_SAVE_FILTER);
+	if (path.isEmpty()) {
+		return;
+	}
+	if (!Trace::exportChromeJSON(path)) {
+		QMessageBox::warning(this, tr("Error"), tr("Failed to write the trace to \"%1\"!").arg(path));
+	}
+}
+#endif
+
+MemoryReport Window::memoryReport() const {
+	MemoryReport report;
+	this->graph->reportMemory(report);
+	if (this->lastLoadMemory.measured) {
+		report.add("Last load", "Parsed map", this->lastLoadMemory.parsedBytes, -1, MemoryReport::KIND_PEAK);
+		report.add("Last load", "Entities", this->lastLoadMemory.entityBytes, this->lastLoadMemory.entityCount, MemoryReport::KIND_PEAK);
+	} else {
+		report.addNote(tr("The parsed map and entity lists held while loading weren't measured. Turn on Help > Measure Memory While Loading and open the map again to include them."));
+	}
+	this->instanceResolver.reportMemory(report);
+	if (this->fgd) {
+		// File-backed, so the OS can drop these pages whenever it likes
+		report.add("FGD", "Mapped cache", this->fgd->mappedSize(), this->fgd->classCount(), MemoryReport::KIND_EXACT);
+	}
+	this->mapIndexer->reportMemory(report);
+	return report;
+}
+
+void Window::setMeasureLoadMemory(bool measure) {
+	this->measureLoadMemory = measure;
+}
+
+void Window::showMemoryReport() {
+	MemoryReportDialog dialog(this->memoryReport(), this);
+	dialog.exec();
+}
+
 void Window::about() {
 	QString creditsText = "# " ENTGRAPH_PROJECT_NAME_PRETTY " v" ENTGRAPH_PROJECT_VERSION "\n\n<br/>\n\n";
 	QFile creditsFile(QCoreApplication::applicationDirPath() + "/CREDITS.md");
@@ -147,6 +373,11 @@ void Window::clearContents() {
 
 	this->graph->clear();
 	this->graph->setDisabled(true);
+	this->statusBar()->clearMessage();
+	this->diagnostics->clear();
+	this->lastLoadMemory = {};
+	// Instances are only shared within one load (or both sides of a comparison), so don't keep every version ever parsed
+	this->instanceResolver.clearCache();
 
 	this->markModified(false);
 	this->freezeActions(true, false); // Leave creation actions unfrozen
@@ -160,55 +391,91 @@ void Window::closeEvent(QCloseEvent* event) {
 	event->accept();
 }
 
+bool Window::openPath(const QString& path) {
+	const bool loaded = this->load(path);
+	if (!loaded) {
+		this->clearContents();
+	}
+	this->graph->setDisabled(false);
+	return loaded;
+}
+
 bool Window::load(const QString& path) {
+	ENTGRAPH_TRACE_SCOPE("Window::load", "io");
 	this->clearContents();
 	this->freezeActions(true);
 
-	// todo: load map
-#if 0
-	VMFWrapper vmfWrapper{path};
-	if (!vmfWrapper) {
+	LoadMemory memory{.measured = this->measureLoadMemory};
+	const auto entities = this->readEntities(path, memory.measured ? &memory : nullptr);
+	if (!entities) {
 		return false;
 	}
-	auto entities = vmfWrapper.getEntities();
-	auto& model = this->graph->model();
-	QMap<QString, NodeId> namedEntityIds;
-
-    // todo: fgd parser
-    QMap<QString, QMap<QString, PortIndex>> entityInputs{
-            {"logic_relay", {{"Enable", 0}, {"Disable", 1}}},
-    };
+	this->lastLoadMemory = memory;
 
-	for (auto& entity : entities) {
-		NodeId id = model.addNode(entity.classname, entity.id);
-		if (!entity.targetname.isEmpty()) {
-			namedEntityIds[entity.targetname] = id;
-		}
-		model.setNodeData(id, NodeRole::Caption, entity.targetname.isEmpty() ? entity.classname : entity.targetname + " (" + entity.classname + ")");
-		model.setNodeData(id, NodeRole::Position, QPointF(0, 0));
-	}
-	for (auto& entity : entities) {
-        NodeId id = entity.id;
-        model.setNodeData(id, NodeRole::InPortCount, entityInputs[entity.classname].size());
-        for (PortIndex i = 0; i < entityInputs[entity.classname].size(); i++) {
-            model.setPortData(id, PortType::In, i, QVariant::fromValue(ConnectionPolicy::Many), PortRole::ConnectionPolicyRole);
-            model.setPortData(id, PortType::In, i, entityInputs[entity.classname].key(i), PortRole::Caption);
-        }
-        model.setNodeData(id, NodeRole::OutPortCount, entity.connections.length());
-        for (PortIndex i = 0; i < entity.connections.length(); i++) {
-            model.setPortData(id, PortType::Out, i, QVariant::fromValue(ConnectionPolicy::Many), PortRole::ConnectionPolicyRole);
-            model.setPortData(id, PortType::Out, i, entity.connections[i].output, PortRole::Caption);
-            if (namedEntityIds.contains(entity.connections[i].targetname)) {
-				model.addConnection({static_cast<NodeId>(entity.id), i, namedEntityIds[entity.connections[i].targetname], entityInputs[entity.targetname][entity.connections[i].output]});
-			}
-        }
+	if (!this->fgd) {
+		this->loadFGD();
 	}
-#endif
+	this->graph->model().loadEntities(*entities, this->fgd.get());
+
+	QElapsedTimer validateTimer;
+	validateTimer.start();
+	const auto problems = EntityValidator{this->fgd.get()}.validate(*entities);
+	this->diagnostics->setDiagnostics(problems, this->graph->model(), validateTimer.nsecsElapsed());
 
 	this->freezeActions(false);
 	return true;
 }
 
+std::optional<QList<EntityKV>> Window::readEntities(const QString& path, LoadMemory* memory) {
+	ENTGRAPH_TRACE_SCOPE("Window::readEntities", "io");
+	const auto recordEntities = [memory](const QList<EntityKV>& entities) {
+		if (memory) {
+			memory->entityBytes = entityMemoryUsage(entities);
+			memory->entityCount = entities.size();
+		}
+	};
+
+	if (path.endsWith(".bsp", Qt::CaseInsensitive)) {
+		BSPEntityKVParser parser{path};
+		if (!parser) {
+			return std::nullopt;
+		}
+		auto entities = parser.getEntities();
+		if (memory) {
+			// The parsed tree points into the lump instead of copying out of it, so this is most of it
+			memory->parsedBytes = MemoryUsage::heap(parser.getEntityLump());
+		}
+		recordEntities(entities);
+		return entities;
+	}
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return std::nullopt;
+	}
+	EntityKVParser parser{QString::fromUtf8(file.readAll())};
+	file.close();
+	if (!parser) {
+		return std::nullopt;
+	}
+	if (memory) {
+		memory->parsedBytes = parser.memoryUsage();
+	}
+	auto entities = this->instanceResolver.resolve(path, parser.getEntities(), parser.getInstances());
+	recordEntities(entities);
+	return entities;
+}
+
+bool Window::loadFGD() {
+	this->fgd.reset();
+	auto path = Options::get<QString>(OPT_FGD_PATH);
+	if (path.isEmpty()) {
+		return false;
+	}
+	this->fgd = FGDCache::open(path, Options::getCacheDirectory());
+	return this->fgd != nullptr;
+}
+
 bool Window::promptUserToKeepModifications() {
 	auto response = QMessageBox::warning(this, tr("Save changes?"), tr("Hold up! Would you like to save your changes first?"), QMessageBox::Ok | QMessageBox::Discard | QMessageBox::Cancel);
 	if (response == QMessageBox::Cancel) {
@@ -229,4 +496,5 @@ void Window::freezeActions(bool freeze, bool freezeCreationActions) {
 	this->saveAction->setDisabled(freeze || !this->modified);
 	this->saveAsAction->setDisabled(freeze);
 	this->closeFileAction->setDisabled(freeze);
+	this->exportMenu->setDisabled(freeze);
 }
@@ -1,12 +1,25 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+
 #include <QMainWindow>
 
+#include "config/Config.h"
+
+#include "graph/EntityGraphExporter.h"
+#include "wrapper/InstanceResolver.h"
+
 class QAction;
 class QCloseEvent;
+class QMenu;
 class QSettings;
 
+class EntityDiagnosticsPanel;
 class EntityGraph;
+class FGDCache;
+class MapIndexer;
+class MemoryReport;
 
 class Window : public QMainWindow {
 	Q_OBJECT;
@@ -14,14 +27,42 @@ class Window : public QMainWindow {
 public:
 	explicit Window(QWidget* parent = nullptr);
 
+	~Window() override;
+
 	void open(const QString& startPath = QString());
 
+	/// Loads a map without asking for one. Returns false if it couldn't be loaded
+	bool openPath(const QString& path);
+
+	/// Shows how the entity I/O changed between two revisions of a map
+	void compareRevisions();
+
 	void save();
 
 	void saveAs();
 
 	void closeFile();
 
+	void exportGraph(EntityGraphExporter::Format format);
+
+	void chooseFGD();
+
+	void searchInstalledMaps();
+
+#if ENTGRAPH_ENABLE_TRACING
+	void exportTrace();
+#endif
+
+	/// How much memory the loaded map and everything cached alongside it are using
+	[[nodiscard]] MemoryReport memoryReport() const;
+
+	/// Also measures what loading a map held onto along the way, for the report. Walking everything
+	/// that was parsed costs about as much as parsing it, so this is off unless the option is set
+	/// or a report was asked for on the command line
+	void setMeasureLoadMemory(bool measure);
+
+	void showMemoryReport();
+
 	void about();
 
 	void aboutQt();
@@ -34,17 +75,39 @@ protected:
 	void closeEvent(QCloseEvent* event) override;
 
 private:
+	/// Estimated sizes of what was only held while loading the current map
+	struct LoadMemory {
+		bool measured = false;
+		qint64 parsedBytes = 0;
+		qint64 entityBytes = 0;
+		qsizetype entityCount = 0;
+	};
+
 	EntityGraph* graph;
+	EntityDiagnosticsPanel* diagnostics;
+	std::unique_ptr<FGDCache> fgd;
+	InstanceResolver instanceResolver;
+	MapIndexer* mapIndexer;
 
 	QAction* openAction;
 	QAction* saveAction;
 	QAction* saveAsAction;
 	QAction* closeFileAction;
+	QMenu* exportMenu;
 
 	bool modified;
+	bool measureLoadMemory;
+	LoadMemory lastLoadMemory;
 
 	bool load(const QString& path);
 
+	/// Reads a VMF (with its instances expanded) or a BSP. Safe to call from any thread,
+	/// as long as each thread passes its own memory to fill in
+	[[nodiscard]] std::optional<QList<EntityKV>> readEntities(const QString& path, LoadMemory* memory = nullptr);
+
+	/// Maps the FGD set in the options, rebuilding its cache if it changed. Returns false if there's no usable FGD
+	bool loadFGD();
+
 	[[nodiscard]] bool promptUserToKeepModifications();
 
 	void freezeActions(bool freeze, bool freezeCreationActions = true);
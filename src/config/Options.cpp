@@ -2,6 +2,7 @@
 
 #include <QApplication>
 #include <QFileInfo>
+#include <QStandardPaths>
 #include <QStyle>
 
 QSettings* opts = nullptr;
@@ -11,6 +12,13 @@ bool Options::isStandalone() {
     return !(nonportable.exists() && nonportable.isFile());
 }
 
+QString Options::getCacheDirectory() {
+    if (isStandalone()) {
+        return QApplication::applicationDirPath() + "/cache";
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+}
+
 void Options::setupOptions(QSettings& options) {
     if (!options.contains(OPT_STYLE)) {
         options.setValue(OPT_STYLE, QApplication::style()->name());
@@ -21,6 +29,22 @@ void Options::setupOptions(QSettings& options) {
         options.setValue(OPT_START_MAXIMIZED, false);
     }
 
+    if (!options.contains(OPT_FGD_PATH)) {
+        options.setValue(OPT_FGD_PATH, QString());
+    }
+
+    if (!options.contains(OPT_SHOW_MINIMAP)) {
+        options.setValue(OPT_SHOW_MINIMAP, true);
+    }
+
+    if (!options.contains(OPT_BUNDLE_CONNECTIONS)) {
+        options.setValue(OPT_BUNDLE_CONNECTIONS, false);
+    }
+
+    if (!options.contains(OPT_MEASURE_LOAD_MEMORY)) {
+        options.setValue(OPT_MEASURE_LOAD_MEMORY, false);
+    }
+
 	opts = &options;
 }
 
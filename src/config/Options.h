@@ -6,11 +6,18 @@
 
 constexpr std::string_view OPT_STYLE = "style";
 constexpr std::string_view OPT_START_MAXIMIZED = "start_maximized";
+constexpr std::string_view OPT_FGD_PATH = "fgd_path";
+constexpr std::string_view OPT_SHOW_MINIMAP = "show_minimap";
+constexpr std::string_view OPT_BUNDLE_CONNECTIONS = "bundle_connections";
+constexpr std::string_view OPT_MEASURE_LOAD_MEMORY = "measure_load_memory";
 
 namespace Options {
 
 bool isStandalone();
 
+/// Where to keep files that can be regenerated, like the FGD cache
+QString getCacheDirectory();
+
 void setupOptions(QSettings& options);
 
 QSettings* getOptions();
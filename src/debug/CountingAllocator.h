@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// Counts the bytes currently allocated through it for a tag, so memory used by std containers can be reported exactly.
+/// The tag is a struct with a static std::atomic_int64_t named bytes, and is shared by every container using it.
+template<typename T, typename Tag>
+struct CountingAllocator {
+	using value_type = T;
+
+	CountingAllocator() noexcept = default;
+
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U, Tag>& /*other*/) noexcept {} // NOLINT(*-explicit-constructor)
+
+	[[nodiscard]] T* allocate(std::size_t n) {
+		auto* out = std::allocator<T>{}.allocate(n);
+		Tag::bytes.fetch_add(static_cast<std::int64_t>(n * sizeof(T)), std::memory_order_relaxed);
+		return out;
+	}
+
+	void deallocate(T* p, std::size_t n) noexcept {
+		Tag::bytes.fetch_sub(static_cast<std::int64_t>(n * sizeof(T)), std::memory_order_relaxed);
+		std::allocator<T>{}.deallocate(p, n);
+	}
+
+	template<typename U>
+	bool operator==(const CountingAllocator<U, Tag>& /*other*/) const noexcept {
+		return true;
+	}
+};
@@ -0,0 +1,109 @@
+#include "MemoryReport.h"
+
+#include <algorithm>
+
+#include <QFile>
+#include <QLocale>
+#include <QMap>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+void MemoryReport::add(const QString& subsystem, const QString& name, qint64 bytes, qint64 count, Kind kind) {
+	this->entries.push_back({subsystem, name, bytes, count, kind});
+}
+
+void MemoryReport::addNote(const QString& note) {
+	this->notes.push_back(note);
+}
+
+const QList<MemoryReport::Entry>& MemoryReport::getEntries() const {
+	return this->entries;
+}
+
+const QStringList& MemoryReport::getNotes() const {
+	return this->notes;
+}
+
+qint64 MemoryReport::getTotalBytes() const {
+	qint64 total = 0;
+	for (const auto& entry : this->entries) {
+		if (entry.kind != KIND_PEAK) {
+			total += entry.bytes;
+		}
+	}
+	return total;
+}
+
+qint64 MemoryReport::getProcessResidentBytes() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return static_cast<qint64>(counters.WorkingSetSize);
+	}
+#elif defined(__linux__)
+	// Total program size, then resident size, in pages
+	QFile statm("/proc/self/statm");
+	if (statm.open(QIODevice::ReadOnly)) {
+		const auto fields = statm.readAll().split(' ');
+		if (fields.size() > 1) {
+			return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+		}
+	}
+#endif
+	return -1;
+}
+
+QString MemoryReport::toText() const {
+	const QLocale locale;
+
+	// Keep subsystems in the order they were first added
+	QStringList subsystems;
+	QMap<QString, QList<const Entry*>> entriesBySubsystem;
+	for (const auto& entry : this->entries) {
+		if (!entriesBySubsystem.contains(entry.subsystem)) {
+			subsystems.push_back(entry.subsystem);
+		}
+		entriesBySubsystem[entry.subsystem].push_back(&entry);
+	}
+
+	qsizetype nameWidth = 0;
+	for (const auto& entry : this->entries) {
+		nameWidth = std::max(nameWidth, entry.name.size() + 2);
+	}
+
+	QString out;
+	for (const auto& subsystem : subsystems) {
+		qint64 subtotal = 0;
+		for (const auto* entry : entriesBySubsystem[subsystem]) {
+			if (entry->kind != KIND_PEAK) {
+				subtotal += entry->bytes;
+			}
+		}
+		out += QString("%1 (%2)\n").arg(subsystem, locale.formattedDataSize(subtotal));
+		for (const auto* entry : entriesBySubsystem[subsystem]) {
+			out += QString("  %1 %2").arg(entry->name, -static_cast<int>(nameWidth)).arg(locale.formattedDataSize(entry->bytes), 10);
+			if (entry->count >= 0) {
+				out += QString(" in %1").arg(entry->count);
+			}
+			if (entry->kind == KIND_ESTIMATE) {
+				out += " (estimate)";
+			} else if (entry->kind == KIND_PEAK) {
+				out += " (peak, freed)";
+			}
+			out += '\n';
+		}
+	}
+	out += QString("Total tracked: %1\n").arg(locale.formattedDataSize(this->getTotalBytes()));
+	if (const auto resident = getProcessResidentBytes(); resident >= 0) {
+		out += QString("Process resident: %1\n").arg(locale.formattedDataSize(resident));
+	}
+	for (const auto& note : this->notes) {
+		out += note + '\n';
+	}
+	return out;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/// Bytes used by each part of the program, for a Help menu dialog and the --memory-report command line option.
+/// Entries counted by a CountingAllocator are exact, the rest are estimated from sizes and capacities.
+class MemoryReport {
+public:
+	enum Kind {
+		/// Worked out from sizes and capacities
+		KIND_ESTIMATE,
+		/// Counted allocation by allocation
+		KIND_EXACT,
+		/// Estimated bytes held at one point while loading and freed since. Not part of the total
+		KIND_PEAK,
+	};
+
+	struct Entry {
+		QString subsystem;
+		QString name;
+		qint64 bytes;
+		/// How many things the bytes are spread over, or -1 if that doesn't make sense
+		qint64 count;
+		Kind kind;
+	};
+
+	void add(const QString& subsystem, const QString& name, qint64 bytes, qint64 count = -1, Kind kind = KIND_ESTIMATE);
+
+	/// A line shown under the entries, for anything the report couldn't cover
+	void addNote(const QString& note);
+
+	[[nodiscard]] const QList<Entry>& getEntries() const;
+
+	[[nodiscard]] const QStringList& getNotes() const;
+
+	/// Everything still allocated, so peak entries are left out
+	[[nodiscard]] qint64 getTotalBytes() const;
+
+	/// Resident set size of the whole process as the OS sees it, or -1 if it's unknown on this platform
+	[[nodiscard]] static qint64 getProcessResidentBytes();
+
+	/// Plain text table, grouped by subsystem
+	[[nodiscard]] QString toText() const;
+
+private:
+	QList<Entry> entries;
+	QStringList notes;
+};
+
+/// Heap bytes owned by common containers, not counting the container object itself.
+/// Implicitly shared Qt data is counted once per owner, so totals err on the high side.
+namespace MemoryUsage {
+
+/// Header Qt puts in front of every QString, QByteArray and QList allocation
+inline constexpr qint64 QT_ARRAY_HEADER = 2 * sizeof(void*);
+
+inline qint64 heap(const QString& str) {
+	return str.capacity() > 0 ? QT_ARRAY_HEADER + (str.capacity() + 1) * static_cast<qint64>(sizeof(QChar)) : 0;
+}
+
+inline qint64 heap(const QByteArray& bytes) {
+	return bytes.capacity() > 0 ? QT_ARRAY_HEADER + bytes.capacity() + 1 : 0;
+}
+
+template<typename T>
+qint64 heap(const QList<T>& list) {
+	return list.capacity() > 0 ? QT_ARRAY_HEADER + list.capacity() * static_cast<qint64>(sizeof(T)) : 0;
+}
+
+template<typename K, typename V>
+qint64 heap(const QHash<K, V>& hash) {
+	// QHash keeps 128 slots per span, each an offset byte plus room for one node
+	constexpr qint64 SPAN_SIZE = 128;
+	const auto spans = (hash.capacity() + SPAN_SIZE - 1) / SPAN_SIZE;
+	return spans * (SPAN_SIZE + static_cast<qint64>(sizeof(void*)) * 2) + hash.capacity() * static_cast<qint64>(sizeof(K) + sizeof(V));
+}
+
+template<typename K>
+qint64 heap(const QSet<K>& set) {
+	constexpr qint64 SPAN_SIZE = 128;
+	const auto spans = (set.capacity() + SPAN_SIZE - 1) / SPAN_SIZE;
+	return spans * (SPAN_SIZE + static_cast<qint64>(sizeof(void*)) * 2) + set.capacity() * static_cast<qint64>(sizeof(K));
+}
+
+inline qint64 heap(const std::string& str) {
+	// Short strings live inside the object
+	return str.capacity() >= sizeof(std::string) ? static_cast<qint64>(str.capacity()) + 1 : 0;
+}
+
+template<typename T>
+qint64 heap(const std::vector<T>& vector) {
+	return static_cast<qint64>(vector.capacity() * sizeof(T));
+}
+
+/// Any node-based std map or set
+template<typename Map>
+qint64 heapOfNodes(const Map& map) {
+	// Each node holds the value and a pointer or two to link it to the others
+	qint64 bytes = static_cast<qint64>(map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*)));
+	if constexpr (requires { map.bucket_count(); }) {
+		bytes += static_cast<qint64>(map.bucket_count() * sizeof(void*));
+	}
+	return bytes;
+}
+
+} // namespace MemoryUsage
@@ -0,0 +1,83 @@
+#include "MemoryReportDialog.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "MemoryReport.h"
+
+MemoryReportDialog::MemoryReportDialog(const MemoryReport& report, QWidget* parent)
+		: QDialog(parent) {
+	this->setWindowTitle(tr("Memory Report"));
+	this->setMinimumSize(600, 400);
+
+	auto* layout = new QVBoxLayout(this);
+
+	auto* tree = new QTreeWidget(this);
+	tree->setHeaderLabels({tr("Name"), tr("Size"), tr("Count"), tr("Accuracy")});
+	tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+	layout->addWidget(tree, 1);
+
+	const QLocale locale;
+	QHash<QString, QTreeWidgetItem*> subsystems;
+	QHash<QTreeWidgetItem*, qint64> subtotals;
+	for (const auto& entry : report.getEntries()) {
+		auto*& subsystem = subsystems[entry.subsystem];
+		if (!subsystem) {
+			subsystem = new QTreeWidgetItem(tree, {entry.subsystem});
+			subsystem->setExpanded(true);
+		}
+		if (entry.kind != MemoryReport::KIND_PEAK) {
+			subtotals[subsystem] += entry.bytes;
+		}
+
+		QString accuracy;
+		switch (entry.kind) {
+			case MemoryReport::KIND_ESTIMATE:
+				accuracy = tr("Estimate");
+				break;
+			case MemoryReport::KIND_EXACT:
+				accuracy = tr("Exact");
+				break;
+			case MemoryReport::KIND_PEAK:
+				accuracy = tr("Peak while loading, freed");
+				break;
+		}
+		auto* item = new QTreeWidgetItem(subsystem, {entry.name, locale.formattedDataSize(entry.bytes), entry.count >= 0 ? locale.toString(entry.count) : QString(), accuracy});
+		item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+		item->setTextAlignment(2, Qt::AlignRight | Qt::AlignVCenter);
+	}
+	for (const auto& [subsystem, subtotal] : subtotals.asKeyValueRange()) {
+		subsystem->setText(1, locale.formattedDataSize(subtotal));
+		subsystem->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+	}
+	tree->resizeColumnToContents(1);
+	tree->resizeColumnToContents(2);
+
+	auto totalText = tr("Total tracked: %1").arg(locale.formattedDataSize(report.getTotalBytes()));
+	if (const auto resident = MemoryReport::getProcessResidentBytes(); resident >= 0) {
+		totalText += "\n" + tr("Process resident: %1").arg(locale.formattedDataSize(resident));
+	}
+	for (const auto& note : report.getNotes()) {
+		totalText += "\n" + note;
+	}
+	auto* totalLabel = new QLabel(totalText, this);
+	totalLabel->setWordWrap(true);
+	layout->addWidget(totalLabel);
+
+	auto* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+	auto* copyButton = buttons->addButton(tr("&Copy as Text"), QDialogButtonBox::ActionRole);
+	layout->addWidget(buttons);
+
+	const auto text = report.toText();
+	QObject::connect(copyButton, &QPushButton::clicked, this, [text] {
+		QApplication::clipboard()->setText(text);
+	});
+	QObject::connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+}
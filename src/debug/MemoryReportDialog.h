@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QDialog>
+
+class MemoryReport;
+
+/// Shows a MemoryReport as a tree of subsystems, with a button to copy it as text
+class MemoryReportDialog : public QDialog {
+	Q_OBJECT;
+
+public:
+	explicit MemoryReportDialog(const MemoryReport& report, QWidget* parent = nullptr);
+};
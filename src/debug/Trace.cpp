@@ -0,0 +1,156 @@
+#include "Trace.h"
+
+#if ENTGRAPH_ENABLE_TRACING
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QThread>
+
+namespace {
+
+struct Event {
+	const char* name;
+	const char* category;
+	std::int64_t startNs;
+	std::int64_t durationNs;
+};
+
+/// One per thread that records anything. Only its own thread appends to it, so the mutex
+/// is uncontended except while exporting
+struct ThreadBuffer {
+	int threadId;
+	QString threadName;
+	std::vector<Event> events;
+	std::mutex mutex;
+};
+
+struct Registry {
+	Trace::Clock::time_point epoch = Trace::Clock::now();
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	std::mutex mutex;
+};
+
+Registry& registry() {
+	static Registry instance;
+	return instance;
+}
+
+// Pin the epoch to startup rather than to whenever the first span ends
+[[maybe_unused]] const Registry& startupRegistry = registry();
+
+ThreadBuffer& threadBuffer() {
+	// Held by the registry too, so the events outlive the thread
+	thread_local const std::shared_ptr<ThreadBuffer> buffer = [] {
+		auto out = std::make_shared<ThreadBuffer>();
+		out->events.reserve(4096);
+
+		auto& reg = registry();
+		const std::lock_guard lock(reg.mutex);
+		out->threadId = static_cast<int>(reg.buffers.size()) + 1;
+		if (QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread()) {
+			out->threadName = "Main";
+		} else if (const auto objectName = QThread::currentThread()->objectName(); !objectName.isEmpty()) {
+			out->threadName = objectName;
+		} else {
+			out->threadName = QString("Worker %1").arg(out->threadId);
+		}
+		reg.buffers.push_back(out);
+		return out;
+	}();
+	return *buffer;
+}
+
+/// Names are literals from our own code, but don't let a stray quote break the file
+QByteArray escapeJSON(const char* str) {
+	QByteArray out;
+	for (const char* c = str; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			out += '\\';
+		}
+		out += *c;
+	}
+	return out;
+}
+
+} // namespace
+
+void Trace::record(const char* name, const char* category, Clock::time_point start, Clock::time_point end) {
+	const auto epoch = registry().epoch;
+	auto& buffer = threadBuffer();
+	const std::lock_guard lock(buffer.mutex);
+	buffer.events.push_back({
+		.name = name,
+		.category = category,
+		.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(),
+		.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+	});
+}
+
+bool Trace::exportChromeJSON(const QString& path) {
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	{
+		auto& reg = registry();
+		const std::lock_guard lock(reg.mutex);
+		buffers = reg.buffers;
+	}
+
+	// Written a buffer at a time, a long session can have millions of spans
+	QByteArray chunk = R"({"displayTimeUnit":"ms","traceEvents":[)";
+	bool first = true;
+	const auto separator = [&first]() -> QByteArray {
+		return std::exchange(first, false) ? QByteArray() : QByteArray(",\n");
+	};
+	for (const auto& buffer : buffers) {
+		const std::lock_guard lock(buffer->mutex);
+		chunk += separator();
+		chunk += R"({"ph":"M","name":"thread_name","pid":1,"tid":)" + QByteArray::number(buffer->threadId);
+		chunk += R"(,"args":{"name":")" + escapeJSON(buffer->threadName.toUtf8().constData()) + "\"}}";
+		for (const auto& event : buffer->events) {
+			chunk += separator();
+			chunk += R"({"ph":"X","pid":1,"tid":)" + QByteArray::number(buffer->threadId);
+			chunk += R"(,"name":")" + escapeJSON(event.name);
+			chunk += R"(","cat":")" + escapeJSON(event.category);
+			chunk += R"(","ts":)" + QByteArray::number(static_cast<double>(event.startNs) / 1000.0, 'f', 3);
+			chunk += R"(,"dur":)" + QByteArray::number(static_cast<double>(event.durationNs) / 1000.0, 'f', 3) + '}';
+			if (chunk.size() > 1 << 20) {
+				file.write(chunk);
+				chunk.clear();
+			}
+		}
+	}
+	chunk += "]}\n";
+	file.write(chunk);
+	return file.commit();
+}
+
+void Trace::clear() {
+	auto& reg = registry();
+	const std::lock_guard lock(reg.mutex);
+	for (const auto& buffer : reg.buffers) {
+		const std::lock_guard bufferLock(buffer->mutex);
+		buffer->events.clear();
+	}
+}
+
+std::size_t Trace::eventCount() {
+	auto& reg = registry();
+	const std::lock_guard lock(reg.mutex);
+	std::size_t count = 0;
+	for (const auto& buffer : reg.buffers) {
+		const std::lock_guard bufferLock(buffer->mutex);
+		count += buffer->events.size();
+	}
+	return count;
+}
+
+#endif
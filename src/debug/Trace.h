@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../config/Config.h"
+
+#if ENTGRAPH_ENABLE_TRACING
+
+#include <chrono>
+#include <cstdint>
+
+#include <QString>
+
+/// Scoped spans recorded into per-thread buffers, exportable as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+/// Names and categories must be string literals, recording a span never allocates beyond growing its thread's buffer.
+/// Only compiled in with ENTGRAPH_ENABLE_TRACING, use the macros below so the calls disappear otherwise.
+namespace Trace {
+
+using Clock = std::chrono::steady_clock;
+
+void record(const char* name, const char* category, Clock::time_point start, Clock::time_point end);
+
+/// Writes every span recorded so far. Safe to call while other threads are still recording
+bool exportChromeJSON(const QString& path);
+
+void clear();
+
+[[nodiscard]] std::size_t eventCount();
+
+class Scope {
+public:
+	Scope(const char* name_, const char* category_)
+			: name(name_)
+			, category(category_)
+			, start(Clock::now()) {}
+
+	~Scope() {
+		record(this->name, this->category, this->start, Clock::now());
+	}
+
+	Scope(const Scope&) = delete;
+	Scope& operator=(const Scope&) = delete;
+
+private:
+	const char* name;
+	const char* category;
+	Clock::time_point start;
+};
+
+} // namespace Trace
+
+#define ENTGRAPH_TRACE_CONCAT_INNER(a, b) a##b
+#define ENTGRAPH_TRACE_CONCAT(a, b) ENTGRAPH_TRACE_CONCAT_INNER(a, b)
+
+/// Records a span from here to the end of the enclosing scope
+#define ENTGRAPH_TRACE_SCOPE(name, category) const ::Trace::Scope ENTGRAPH_TRACE_CONCAT(entgraphTraceScope, __LINE__){name, category}
+
+#else
+
+#define ENTGRAPH_TRACE_SCOPE(name, category) static_cast<void>(0)
+
+#endif
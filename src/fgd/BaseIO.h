@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+#include <QStringView>
+
+/// Inputs and outputs every Source entity gets from CBaseEntity, regardless of what its FGD says.
+/// Names are resolved through a perfect hash built at compile time, so looking one up never allocates.
+namespace BaseIO {
+
+constexpr std::array<std::string_view, 31> INPUTS{
+	"Kill",
+	"KillHierarchy",
+	"Use",
+	"Alpha",
+	"AlternativeSorting",
+	"Color",
+	"SetParent",
+	"SetParentAttachment",
+	"SetParentAttachmentMaintainOffset",
+	"ClearParent",
+	"SetDamageFilter",
+	"EnableDamageForces",
+	"DisableDamageForces",
+	"DispatchEffect",
+	"DispatchResponse",
+	"AddContext",
+	"RemoveContext",
+	"ClearContext",
+	"DisableShadow",
+	"EnableShadow",
+	"AddOutput",
+	"FireUser1",
+	"FireUser2",
+	"FireUser3",
+	"FireUser4",
+	"RunScriptFile",
+	"RunScriptCode",
+	"CallScriptFunction",
+	"SetLocalOrigin",
+	"SetLocalAngles",
+	"KillIfNotVisible",
+};
+
+constexpr std::array<std::string_view, 5> OUTPUTS{
+	"OnUser1",
+	"OnUser2",
+	"OnUser3",
+	"OnUser4",
+	"OnKilled",
+};
+
+namespace detail {
+
+constexpr char16_t codeUnit(char c) {
+	return static_cast<unsigned char>(c);
+}
+
+constexpr char16_t codeUnit(QChar c) {
+	return c.unicode();
+}
+
+constexpr char16_t toLower(char16_t c) {
+	return (c >= 'A' && c <= 'Z') ? static_cast<char16_t>(c + ('a' - 'A')) : c;
+}
+
+/// Seeded FNV-1a over ASCII-lowercased code units
+template<typename String>
+constexpr uint32_t hash(const String& str, uint32_t seed) {
+	uint32_t h = 0x811c9dc5 ^ seed;
+	for (std::size_t i = 0; i < static_cast<std::size_t>(str.size()); i++) {
+		h = (h ^ toLower(codeUnit(str[i]))) * 0x01000193;
+	}
+	return h ^ (h >> 15);
+}
+
+template<typename String>
+constexpr bool equalsIgnoreCase(const String& str, std::string_view name) {
+	if (static_cast<std::size_t>(str.size()) != name.size()) {
+		return false;
+	}
+	for (std::size_t i = 0; i < name.size(); i++) {
+		if (toLower(codeUnit(str[i])) != toLower(codeUnit(name[i]))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<std::size_t N>
+struct PerfectHashTable {
+	/// Big enough that a collision-free seed turns up after a few tries
+	static constexpr std::size_t SIZE = std::bit_ceil(N * 4);
+
+	uint32_t seed = 0;
+	std::array<int16_t, SIZE> slots{};
+};
+
+template<std::size_t N>
+consteval PerfectHashTable<N> makePerfectHashTable(const std::array<std::string_view, N>& names) {
+	PerfectHashTable<N> table;
+	for (uint32_t seed = 1;; seed++) {
+		table.seed = seed;
+		table.slots.fill(-1);
+		bool collided = false;
+		for (std::size_t i = 0; i < N && !collided; i++) {
+			auto& slot = table.slots[hash(names[i], seed) & (PerfectHashTable<N>::SIZE - 1)];
+			if (slot != -1) {
+				collided = true;
+			} else {
+				slot = static_cast<int16_t>(i);
+			}
+		}
+		if (!collided) {
+			return table;
+		}
+	}
+}
+
+template<std::size_t N, typename String>
+constexpr int find(const PerfectHashTable<N>& table, const std::array<std::string_view, N>& names, const String& name) {
+	const auto index = table.slots[hash(name, table.seed) & (PerfectHashTable<N>::SIZE - 1)];
+	return (index >= 0 && equalsIgnoreCase(name, names[index])) ? index : -1;
+}
+
+constexpr auto INPUT_TABLE = makePerfectHashTable(INPUTS);
+constexpr auto OUTPUT_TABLE = makePerfectHashTable(OUTPUTS);
+
+} // namespace detail
+
+/// Index into INPUTS, or -1 if it's not a base input. Case-insensitive
+template<typename String>
+constexpr int findInput(const String& name) {
+	return detail::find(detail::INPUT_TABLE, INPUTS, name);
+}
+
+/// Index into OUTPUTS, or -1 if it's not a base output. Case-insensitive
+template<typename String>
+constexpr int findOutput(const String& name) {
+	return detail::find(detail::OUTPUT_TABLE, OUTPUTS, name);
+}
+
+static_assert(findInput(std::string_view{"kill"}) == 0);
+static_assert(findInput(std::string_view{"FireUser4"}) == 24);
+static_assert(findInput(std::string_view{"NotAnInput"}) == -1);
+static_assert(findOutput(std::string_view{"OnKilled"}) == 4);
+
+} // namespace BaseIO
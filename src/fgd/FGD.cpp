@@ -0,0 +1,402 @@
+#include "FGD.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+
+namespace {
+
+enum class TokenType {
+	STRING,
+	WORD,
+	SYMBOL,
+};
+
+struct Token {
+	TokenType type;
+	QByteArrayView text;
+};
+
+bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+bool isSymbolChar(char c) {
+	switch (c) {
+		case '(':
+		case ')':
+		case '[':
+		case ']':
+		case ':':
+		case '=':
+		case ',':
+		case '+':
+			return true;
+		default:
+			return false;
+	}
+}
+
+QList<Token> tokenize(QByteArrayView data) {
+	QList<Token> tokens;
+	qsizetype i = 0;
+	while (i < data.size()) {
+		const char c = data[i];
+		if (isSpace(c)) {
+			i++;
+		} else if (c == '/' && i + 1 < data.size() && data[i + 1] == '/') {
+			while (i < data.size() && data[i] != '\n') {
+				i++;
+			}
+		} else if (c == '"') {
+			const auto start = ++i;
+			while (i < data.size() && data[i] != '"') {
+				i++;
+			}
+			tokens.push_back({TokenType::STRING, data.sliced(start, i - start)});
+			i++;
+		} else if (isSymbolChar(c)) {
+			tokens.push_back({TokenType::SYMBOL, data.sliced(i, 1)});
+			i++;
+		} else {
+			const auto start = i;
+			while (i < data.size() && !isSpace(data[i]) && data[i] != '"' && !isSymbolChar(data[i])) {
+				i++;
+			}
+			tokens.push_back({TokenType::WORD, data.sliced(start, i - start)});
+		}
+	}
+	return tokens;
+}
+
+class Parser {
+public:
+	explicit Parser(QList<Token> tokens_)
+			: tokens(std::move(tokens_)) {}
+
+	[[nodiscard]] bool atEnd() const {
+		return this->pos >= this->tokens.size();
+	}
+
+	[[nodiscard]] bool isSymbol(char c) const {
+		return !this->atEnd() && this->tokens[this->pos].type == TokenType::SYMBOL && this->tokens[this->pos].text[0] == c;
+	}
+
+	[[nodiscard]] bool isType(TokenType type) const {
+		return !this->atEnd() && this->tokens[this->pos].type == type;
+	}
+
+	[[nodiscard]] bool isDirective() const {
+		return this->isType(TokenType::WORD) && this->tokens[this->pos].text.startsWith('@');
+	}
+
+	Token next() {
+		if (this->atEnd()) {
+			return {TokenType::SYMBOL, {}};
+		}
+		return this->tokens[this->pos++];
+	}
+
+	bool accept(char c) {
+		if (this->isSymbol(c)) {
+			this->pos++;
+			return true;
+		}
+		return false;
+	}
+
+	/// Reads a quoted string (joining "a" + "b" continuations), or a bare word
+	QString readString() {
+		if (this->isType(TokenType::WORD)) {
+			return QString::fromUtf8(this->next().text);
+		}
+		QString out;
+		while (this->isType(TokenType::STRING)) {
+			out += QString::fromUtf8(this->next().text);
+			if (!this->accept('+')) {
+				break;
+			}
+		}
+		return out;
+	}
+
+	/// Skips a balanced () or [] group, starting on its opening symbol
+	void skipGroup() {
+		int depth = 0;
+		do {
+			const auto token = this->next();
+			if (token.type != TokenType::SYMBOL || token.text.isEmpty()) {
+				continue;
+			}
+			if (token.text[0] == '(' || token.text[0] == '[') {
+				depth++;
+			} else if (token.text[0] == ')' || token.text[0] == ']') {
+				depth--;
+			}
+		} while (depth > 0 && !this->atEnd());
+	}
+
+	/// Skips anything we don't care about, like @mapsize or @AutoVisGroup
+	void skipDirective() {
+		if (this->isSymbol('(')) {
+			this->skipGroup();
+		}
+		while (!this->atEnd() && !this->isSymbol('[') && !this->isDirective()) {
+			this->next();
+		}
+		if (this->isSymbol('[')) {
+			this->skipGroup();
+		}
+	}
+
+	bool parseEntityClass(const QString& classType, FGDEntityClass& entityClass) {
+		entityClass.classType = classType;
+
+		// Helpers like base(...), studio(...), halfgridsnap
+		while (!this->atEnd() && !this->isSymbol('=')) {
+			const auto helper = this->next();
+			if (helper.type != TokenType::WORD) {
+				return false;
+			}
+			if (!this->isSymbol('(')) {
+				continue;
+			}
+			if (helper.text.compare("base", Qt::CaseInsensitive) != 0) {
+				this->skipGroup();
+				continue;
+			}
+			this->next();
+			while (!this->atEnd() && !this->accept(')')) {
+				const auto base = this->next();
+				if (base.type == TokenType::WORD) {
+					entityClass.bases.push_back(QString::fromUtf8(base.text));
+				}
+			}
+		}
+		if (!this->accept('=')) {
+			return false;
+		}
+		entityClass.classname = this->readString();
+		if (this->accept(':')) {
+			entityClass.description = this->readString();
+		}
+		if (!this->accept('[')) {
+			return false;
+		}
+
+		while (!this->atEnd() && !this->accept(']')) {
+			if (this->isDirective()) {
+				this->next();
+				this->skipDirective();
+				continue;
+			}
+			const auto token = this->next();
+			if (token.type != TokenType::WORD) {
+				return false;
+			}
+
+			if ((token.text.compare("input", Qt::CaseInsensitive) == 0 || token.text.compare("output", Qt::CaseInsensitive) == 0) && this->isType(TokenType::WORD)) {
+				FGDInputOutput io;
+				io.name = QString::fromUtf8(this->next().text);
+				if (!this->accept('(')) {
+					return false;
+				}
+				io.type = this->readString();
+				if (!this->accept(')')) {
+					return false;
+				}
+				if (this->accept(':')) {
+					io.description = this->readString();
+				}
+				(token.text.compare("input", Qt::CaseInsensitive) == 0 ? entityClass.inputs : entityClass.outputs).push_back(io);
+				continue;
+			}
+
+			FGDKeyValue kv;
+			kv.name = QString::fromUtf8(token.text);
+			if (!this->accept('(')) {
+				return false;
+			}
+			kv.type = this->readString();
+			if (!this->accept(')')) {
+				return false;
+			}
+			// Modifiers like readonly, report
+			while (this->isType(TokenType::WORD) && (this->tokens[this->pos].text.compare("readonly", Qt::CaseInsensitive) == 0 || this->tokens[this->pos].text.compare("report", Qt::CaseInsensitive) == 0)) {
+				this->next();
+			}
+			if (this->accept(':')) {
+				kv.displayName = this->readString();
+				if (this->accept(':')) {
+					if (!this->isType(TokenType::SYMBOL)) {
+						kv.defaultValue = this->readString();
+					}
+					if (this->accept(':')) {
+						kv.description = this->readString();
+					}
+				}
+			}
+			if (this->accept('=') && this->isSymbol('[')) {
+				this->skipGroup();
+			}
+			entityClass.keyvalues.push_back(kv);
+		}
+		return true;
+	}
+
+private:
+	QList<Token> tokens;
+	qsizetype pos = 0;
+};
+
+template<typename T>
+void mergeMembers(QList<T>& into, const QList<T>& from) {
+	for (const auto& member : from) {
+		auto it = std::find_if(into.begin(), into.end(), [&member](const T& existing) {
+			return existing.name.compare(member.name, Qt::CaseInsensitive) == 0;
+		});
+		if (it != into.end()) {
+			*it = member;
+		} else {
+			into.push_back(member);
+		}
+	}
+}
+
+void mergeClass(FGDEntityClass& into, const FGDEntityClass& from) {
+	mergeMembers(into.keyvalues, from.keyvalues);
+	mergeMembers(into.inputs, from.inputs);
+	mergeMembers(into.outputs, from.outputs);
+}
+
+} // namespace
+
+FGD::FGD(const QString& path) {
+	this->valid = this->parseFile(path);
+}
+
+bool FGD::isValid() const {
+	return this->valid;
+}
+
+FGD::operator bool() const {
+	return this->isValid();
+}
+
+const QList<FGDSourceFile>& FGD::getSourceFiles() const {
+	return this->sourceFiles;
+}
+
+const QList<FGDEntityClass>& FGD::getEntityClasses() const {
+	return this->entityClasses;
+}
+
+QList<FGDEntityClass> FGD::getFlattenedEntityClasses() const {
+	// Later definitions win, except for @ExtendClass which adds to what's already there
+	QHash<QString, FGDEntityClass> declared;
+	QStringList order;
+	for (const auto& entityClass : this->entityClasses) {
+		const auto key = entityClass.classname.toLower();
+		if (auto it = declared.find(key); it != declared.end() && entityClass.classType == "extendclass") {
+			it->bases.append(entityClass.bases);
+			mergeClass(*it, entityClass);
+			continue;
+		}
+		if (!declared.contains(key)) {
+			order.push_back(key);
+		}
+		declared[key] = entityClass;
+	}
+
+	QHash<QString, FGDEntityClass> flattened;
+	QSet<QString> visiting;
+	std::function<const FGDEntityClass*(const QString&)> flatten = [&](const QString& key) -> const FGDEntityClass* {
+		if (auto it = flattened.constFind(key); it != flattened.constEnd()) {
+			return &*it;
+		}
+		auto declaredIt = declared.constFind(key);
+		if (declaredIt == declared.constEnd() || visiting.contains(key)) {
+			return nullptr;
+		}
+		visiting.insert(key);
+
+		FGDEntityClass result;
+		result.classType = declaredIt->classType;
+		result.classname = declaredIt->classname;
+		result.description = declaredIt->description;
+		result.bases = declaredIt->bases;
+		for (const auto& base : declaredIt->bases) {
+			if (const auto* flatBase = flatten(base.toLower())) {
+				mergeClass(result, *flatBase);
+			}
+		}
+		mergeClass(result, *declaredIt);
+
+		visiting.remove(key);
+		return &*flattened.insert(key, std::move(result));
+	};
+
+	QList<FGDEntityClass> out;
+	for (const auto& key : order) {
+		if (declared[key].classType == "baseclass") {
+			continue;
+		}
+		if (const auto* entityClass = flatten(key)) {
+			out.push_back(*entityClass);
+		}
+	}
+	return out;
+}
+
+QByteArray FGD::hashContents(const QByteArray& contents) {
+	return QCryptographicHash::hash(contents, QCryptographicHash::Md5);
+}
+
+bool FGD::parseFile(const QString& path) {
+	const auto absolutePath = QFileInfo(path).absoluteFilePath();
+	for (const auto& sourceFile : this->sourceFiles) {
+		if (sourceFile.path == absolutePath) {
+			// Already included
+			return true;
+		}
+	}
+
+	QFile file(absolutePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	// Taken before reading, so a write that lands in between makes the cache look stale instead of fresh
+	const auto modified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+	const auto contents = file.readAll();
+	file.close();
+	this->sourceFiles.push_back({absolutePath, hashContents(contents), modified, contents.size()});
+
+	const auto directory = QFileInfo(absolutePath).absoluteDir();
+	Parser parser{tokenize(contents)};
+	while (!parser.atEnd()) {
+		if (!parser.isDirective()) {
+			return false;
+		}
+		const auto directive = QString::fromUtf8(parser.next().text.sliced(1)).toLower();
+		if (directive == "include") {
+			if (!this->parseFile(directory.filePath(parser.readString()))) {
+				return false;
+			}
+		} else if (directive.endsWith("class")) {
+			FGDEntityClass entityClass;
+			if (!parser.parseEntityClass(directive, entityClass)) {
+				return false;
+			}
+			this->entityClasses.push_back(std::move(entityClass));
+		} else {
+			parser.skipDirective();
+		}
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+struct FGDKeyValue {
+	QString name;
+	QString type;
+	QString displayName;
+	QString defaultValue;
+	QString description;
+};
+
+struct FGDInputOutput {
+	QString name;
+	QString type;
+	QString description;
+};
+
+struct FGDEntityClass {
+	/// Lowercase, without the @ (e.g. "pointclass")
+	QString classType;
+	QString classname;
+	QString description;
+	QStringList bases;
+
+	QList<FGDKeyValue> keyvalues;
+	QList<FGDInputOutput> inputs;
+	QList<FGDInputOutput> outputs;
+};
+
+struct FGDSourceFile {
+	QString path;
+	QByteArray hash;
+	/// Milliseconds since the epoch, so a cache can tell the file hasn't changed without hashing it
+	qint64 modified;
+	qint64 size;
+};
+
+class FGD {
+public:
+	/// Parses the given FGD and everything it includes
+	explicit FGD(const QString& path);
+
+	[[nodiscard]] bool isValid() const;
+
+	[[nodiscard]] explicit operator bool() const;
+
+	/// Every file that was read while parsing, including the root FGD, with a hash of its contents
+	[[nodiscard]] const QList<FGDSourceFile>& getSourceFiles() const;
+
+	/// Entity classes as written in the FGD, with base classes not yet applied
+	[[nodiscard]] const QList<FGDEntityClass>& getEntityClasses() const;
+
+	/// Placeable entity classes with the keyvalues, inputs and outputs of all their base classes merged in.
+	/// Base classes are applied first, so members the class declares itself come after inherited ones
+	[[nodiscard]] QList<FGDEntityClass> getFlattenedEntityClasses() const;
+
+	/// Hash used to tell whether an FGD on disk changed since it was read
+	[[nodiscard]] static QByteArray hashContents(const QByteArray& contents);
+
+private:
+	QList<FGDSourceFile> sourceFiles;
+	QList<FGDEntityClass> entityClasses;
+	bool valid;
+
+	bool parseFile(const QString& path);
+};
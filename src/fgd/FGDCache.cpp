@@ -0,0 +1,416 @@
+#include "FGDCache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+
+#include "../debug/Trace.h"
+#include "FGD.h"
+
+struct FGDCache::StringRef {
+	/// In UTF-16 code units from the start of the string table
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct FGDCache::Header {
+	char magic[4];
+	uint32_t version;
+	uint32_t sourceCount;
+	uint32_t sourceOffset;
+	uint32_t classCount;
+	uint32_t classOffset;
+	/// Open-addressed table of class indices plus one (zero is an empty bucket), always a power of two
+	uint32_t bucketCount;
+	uint32_t bucketOffset;
+	uint32_t inputOutputCount;
+	uint32_t inputOutputOffset;
+	uint32_t keyValueCount;
+	uint32_t keyValueOffset;
+	uint32_t stringLength;
+	uint32_t stringOffset;
+};
+
+struct FGDCache::SourceEntry {
+	StringRef path;
+	uint8_t hash[16];
+	/// Checked before the hash, which is only needed when these changed
+	int64_t modified;
+	int64_t size;
+};
+
+struct FGDCache::ClassEntry {
+	uint64_t hash;
+	StringRef classname;
+	StringRef description;
+	uint32_t firstInput;
+	uint32_t inputCount;
+	uint32_t firstOutput;
+	uint32_t outputCount;
+	uint32_t firstKeyValue;
+	uint32_t keyValueCount;
+};
+
+struct FGDCache::InputOutputEntry {
+	StringRef name;
+	StringRef type;
+	StringRef description;
+};
+
+struct FGDCache::KeyValueEntry {
+	StringRef name;
+	StringRef type;
+	StringRef displayName;
+	StringRef defaultValue;
+	StringRef description;
+};
+
+namespace {
+
+constexpr char MAGIC[4] = {'E', 'G', 'F', 'C'};
+
+/// FNV-1a over the ASCII-lowercased UTF-16 code units
+uint64_t hashClassname(QStringView classname) {
+	uint64_t hash = 0xcbf29ce484222325;
+	for (auto c : classname) {
+		auto u = c.unicode();
+		if (u >= 'A' && u <= 'Z') {
+			u += 'a' - 'A';
+		}
+		hash = (hash ^ u) * 0x100000001b3;
+	}
+	return hash;
+}
+
+uint32_t alignTo8(qsizetype offset) {
+	return static_cast<uint32_t>((offset + 7) & ~qsizetype{7});
+}
+
+} // namespace
+
+const FGDCache::Header& FGDCache::header() const {
+	return *reinterpret_cast<const Header*>(this->data);
+}
+
+template<typename T>
+const T* FGDCache::section(uint32_t offset) const {
+	return reinterpret_cast<const T*>(this->data + offset);
+}
+
+QStringView FGDCache::string(const StringRef& ref) const {
+	const auto& header = this->header();
+	if (static_cast<uint64_t>(ref.offset) + ref.length > header.stringLength) {
+		return {};
+	}
+	return {reinterpret_cast<const char16_t*>(this->data + header.stringOffset) + ref.offset, static_cast<qsizetype>(ref.length)};
+}
+
+FGDCache::EntityClass::EntityClass(const FGDCache* cache_, const ClassEntry* entry_)
+		: cache(cache_)
+		, entry(entry_) {}
+
+QStringView FGDCache::EntityClass::classname() const {
+	return this->cache->string(this->entry->classname);
+}
+
+QStringView FGDCache::EntityClass::description() const {
+	return this->cache->string(this->entry->description);
+}
+
+qsizetype FGDCache::EntityClass::inputCount() const {
+	return this->entry->inputCount;
+}
+
+FGDCache::InputOutput FGDCache::EntityClass::input(qsizetype index) const {
+	const auto& io = this->cache->section<InputOutputEntry>(this->cache->header().inputOutputOffset)[this->entry->firstInput + index];
+	return {this->cache->string(io.name), this->cache->string(io.type), this->cache->string(io.description)};
+}
+
+qsizetype FGDCache::EntityClass::outputCount() const {
+	return this->entry->outputCount;
+}
+
+FGDCache::InputOutput FGDCache::EntityClass::output(qsizetype index) const {
+	const auto& io = this->cache->section<InputOutputEntry>(this->cache->header().inputOutputOffset)[this->entry->firstOutput + index];
+	return {this->cache->string(io.name), this->cache->string(io.type), this->cache->string(io.description)};
+}
+
+qsizetype FGDCache::EntityClass::keyValueCount() const {
+	return this->entry->keyValueCount;
+}
+
+FGDCache::KeyValue FGDCache::EntityClass::keyValue(qsizetype index) const {
+	const auto& kv = this->cache->section<KeyValueEntry>(this->cache->header().keyValueOffset)[this->entry->firstKeyValue + index];
+	return {this->cache->string(kv.name), this->cache->string(kv.type), this->cache->string(kv.displayName), this->cache->string(kv.defaultValue), this->cache->string(kv.description)};
+}
+
+std::unique_ptr<FGDCache> FGDCache::open(const QString& fgdPath, const QString& cacheDirectory) {
+	ENTGRAPH_TRACE_SCOPE("FGDCache::open", "io");
+	const auto absolutePath = QFileInfo(fgdPath).absoluteFilePath();
+	if (!QDir().mkpath(cacheDirectory)) {
+		return nullptr;
+	}
+	const auto cachePath = QDir(cacheDirectory).filePath(QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Md5).toHex() + ".fgdcache");
+
+	std::unique_ptr<FGDCache> cache{new FGDCache};
+	if (cache->map(cachePath) && cache->isUpToDate()) {
+		return cache;
+	}
+
+	// Unmap the stale cache before replacing it
+	cache.reset(new FGDCache);
+
+	FGD fgd{absolutePath};
+	if (!fgd || !write(cachePath, fgd) || !cache->map(cachePath)) {
+		return nullptr;
+	}
+	return cache;
+}
+
+bool FGDCache::write(const QString& cachePath, const FGD& fgd) {
+	static_assert(sizeof(Header) == 56);
+	static_assert(sizeof(SourceEntry) == 40);
+	static_assert(sizeof(ClassEntry) == 48);
+	static_assert(sizeof(InputOutputEntry) == 24);
+	static_assert(sizeof(KeyValueEntry) == 40);
+
+	const auto entityClasses = fgd.getFlattenedEntityClasses();
+
+	QString strings;
+	QHash<QString, StringRef> stringRefs;
+	const auto addString = [&strings, &stringRefs](const QString& str) -> StringRef {
+		if (auto it = stringRefs.constFind(str); it != stringRefs.constEnd()) {
+			return it.value();
+		}
+		StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(str.size())};
+		strings += str;
+		stringRefs.insert(str, ref);
+		return ref;
+	};
+	const auto addInputOutput = [&addString](const FGDInputOutput& io) -> InputOutputEntry {
+		return {addString(io.name), addString(io.type), addString(io.description)};
+	};
+
+	QList<SourceEntry> sources;
+	for (const auto& sourceFile : fgd.getSourceFiles()) {
+		SourceEntry source{addString(sourceFile.path), {}, sourceFile.modified, sourceFile.size};
+		std::memcpy(source.hash, sourceFile.hash.constData(), std::min<qsizetype>(sizeof(source.hash), sourceFile.hash.size()));
+		sources.push_back(source);
+	}
+
+	QList<ClassEntry> classes;
+	QList<InputOutputEntry> inputOutputs;
+	QList<KeyValueEntry> keyValues;
+	for (const auto& entityClass : entityClasses) {
+		ClassEntry entry{};
+		entry.hash = hashClassname(entityClass.classname);
+		entry.classname = addString(entityClass.classname);
+		entry.description = addString(entityClass.description);
+
+		entry.firstInput = inputOutputs.size();
+		entry.inputCount = entityClass.inputs.size();
+		for (const auto& input : entityClass.inputs) {
+			inputOutputs.push_back(addInputOutput(input));
+		}
+
+		entry.firstOutput = inputOutputs.size();
+		entry.outputCount = entityClass.outputs.size();
+		for (const auto& output : entityClass.outputs) {
+			inputOutputs.push_back(addInputOutput(output));
+		}
+
+		entry.firstKeyValue = keyValues.size();
+		entry.keyValueCount = entityClass.keyvalues.size();
+		for (const auto& kv : entityClass.keyvalues) {
+			keyValues.push_back({addString(kv.name), addString(kv.type), addString(kv.displayName), addString(kv.defaultValue), addString(kv.description)});
+		}
+
+		classes.push_back(entry);
+	}
+
+	uint32_t bucketCount = 1;
+	while (static_cast<qsizetype>(bucketCount) < classes.size() * 2) {
+		bucketCount <<= 1;
+	}
+	QList<uint32_t> buckets(bucketCount, 0);
+	for (qsizetype i = 0; i < classes.size(); i++) {
+		auto slot = static_cast<uint32_t>(classes[i].hash) & (bucketCount - 1);
+		while (buckets[slot]) {
+			slot = (slot + 1) & (bucketCount - 1);
+		}
+		buckets[slot] = i + 1;
+	}
+
+	Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	qsizetype offset = sizeof(Header);
+
+	header.sourceCount = sources.size();
+	header.sourceOffset = alignTo8(offset);
+	offset = header.sourceOffset + sources.size() * sizeof(SourceEntry);
+
+	header.classCount = classes.size();
+	header.classOffset = alignTo8(offset);
+	offset = header.classOffset + classes.size() * sizeof(ClassEntry);
+
+	header.bucketCount = bucketCount;
+	header.bucketOffset = alignTo8(offset);
+	offset = header.bucketOffset + buckets.size() * sizeof(uint32_t);
+
+	header.inputOutputCount = inputOutputs.size();
+	header.inputOutputOffset = alignTo8(offset);
+	offset = header.inputOutputOffset + inputOutputs.size() * sizeof(InputOutputEntry);
+
+	header.keyValueCount = keyValues.size();
+	header.keyValueOffset = alignTo8(offset);
+	offset = header.keyValueOffset + keyValues.size() * sizeof(KeyValueEntry);
+
+	header.stringLength = strings.size();
+	header.stringOffset = alignTo8(offset);
+	offset = header.stringOffset + strings.size() * sizeof(char16_t);
+
+	QByteArray out(offset, '\0');
+	std::memcpy(out.data(), &header, sizeof(Header));
+	std::memcpy(out.data() + header.sourceOffset, sources.constData(), sources.size() * sizeof(SourceEntry));
+	std::memcpy(out.data() + header.classOffset, classes.constData(), classes.size() * sizeof(ClassEntry));
+	std::memcpy(out.data() + header.bucketOffset, buckets.constData(), buckets.size() * sizeof(uint32_t));
+	std::memcpy(out.data() + header.inputOutputOffset, inputOutputs.constData(), inputOutputs.size() * sizeof(InputOutputEntry));
+	std::memcpy(out.data() + header.keyValueOffset, keyValues.constData(), keyValues.size() * sizeof(KeyValueEntry));
+	std::memcpy(out.data() + header.stringOffset, strings.constData(), strings.size() * sizeof(char16_t));
+
+	QSaveFile file(cachePath);
+	if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size()) {
+		return false;
+	}
+	return file.commit();
+}
+
+qsizetype FGDCache::classCount() const {
+	return this->header().classCount;
+}
+
+FGDCache::EntityClass FGDCache::classAt(qsizetype index) const {
+	return {this, this->section<ClassEntry>(this->header().classOffset) + index};
+}
+
+std::optional<FGDCache::EntityClass> FGDCache::findClass(QStringView classname) const {
+	const auto& header = this->header();
+	const auto* buckets = this->section<uint32_t>(header.bucketOffset);
+	const auto* classes = this->section<ClassEntry>(header.classOffset);
+	const auto hash = hashClassname(classname);
+	const auto mask = header.bucketCount - 1;
+	for (uint32_t slot = static_cast<uint32_t>(hash) & mask, probes = 0; probes < header.bucketCount; slot = (slot + 1) & mask, probes++) {
+		const auto index = buckets[slot];
+		if (!index) {
+			break;
+		}
+		const auto& entry = classes[index - 1];
+		if (entry.hash == hash && this->string(entry.classname).compare(classname, Qt::CaseInsensitive) == 0) {
+			return EntityClass{this, &entry};
+		}
+	}
+	return std::nullopt;
+}
+
+qint64 FGDCache::mappedSize() const {
+	return this->size;
+}
+
+bool FGDCache::map(const QString& cachePath) {
+	this->file.setFileName(cachePath);
+	if (!this->file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	this->size = this->file.size();
+	if (this->size < static_cast<qint64>(sizeof(Header))) {
+		return false;
+	}
+	this->data = this->file.map(0, this->size);
+	if (!this->data) {
+		return false;
+	}
+
+	const auto& header = this->header();
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+		return false;
+	}
+	const auto fits = [this](uint32_t offset, uint64_t count, uint64_t elementSize) {
+		return offset % 8 == 0 && offset + count * elementSize <= static_cast<uint64_t>(this->size);
+	};
+	if (!fits(header.sourceOffset, header.sourceCount, sizeof(SourceEntry)) ||
+		!fits(header.classOffset, header.classCount, sizeof(ClassEntry)) ||
+		!fits(header.bucketOffset, header.bucketCount, sizeof(uint32_t)) ||
+		!fits(header.inputOutputOffset, header.inputOutputCount, sizeof(InputOutputEntry)) ||
+		!fits(header.keyValueOffset, header.keyValueCount, sizeof(KeyValueEntry)) ||
+		!fits(header.stringOffset, header.stringLength, sizeof(char16_t)) ||
+		header.bucketCount == 0 || (header.bucketCount & (header.bucketCount - 1)) != 0) {
+		return false;
+	}
+
+	// Check every range once here so lookups don't have to
+	const auto* buckets = this->section<uint32_t>(header.bucketOffset);
+	for (uint32_t i = 0; i < header.bucketCount; i++) {
+		if (buckets[i] > header.classCount) {
+			return false;
+		}
+	}
+	const auto* classes = this->section<ClassEntry>(header.classOffset);
+	for (uint32_t i = 0; i < header.classCount; i++) {
+		const auto& entry = classes[i];
+		if (static_cast<uint64_t>(entry.firstInput) + entry.inputCount > header.inputOutputCount ||
+			static_cast<uint64_t>(entry.firstOutput) + entry.outputCount > header.inputOutputCount ||
+			static_cast<uint64_t>(entry.firstKeyValue) + entry.keyValueCount > header.keyValueCount) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FGDCache::isUpToDate() const {
+	const auto& header = this->header();
+	const auto* sources = this->section<SourceEntry>(header.sourceOffset);
+	for (uint32_t i = 0; i < header.sourceCount; i++) {
+		const QFileInfo info(this->string(sources[i].path).toString());
+		if (!info.exists()) {
+			return false;
+		}
+		if (info.size() == sources[i].size && info.lastModified().toMSecsSinceEpoch() == sources[i].modified) {
+			continue;
+		}
+		// Touched, but maybe not changed
+		QFile sourceFile(info.filePath());
+		if (!sourceFile.open(QIODevice::ReadOnly)) {
+			return false;
+		}
+		const auto hash = FGD::hashContents(sourceFile.readAll());
+		if (hash.size() != sizeof(sources[i].hash) || std::memcmp(hash.constData(), sources[i].hash, sizeof(sources[i].hash)) != 0) {
+			return false;
+		}
+		// Same contents, so remember the new timestamp and skip hashing it next time
+		this->updateSource(i, info.lastModified().toMSecsSinceEpoch(), info.size());
+	}
+	return header.sourceCount > 0;
+}
+
+void FGDCache::updateSource(uint32_t index, int64_t modified, int64_t size) const {
+	static_assert(offsetof(SourceEntry, size) == offsetof(SourceEntry, modified) + sizeof(SourceEntry::modified));
+
+	// The mapping is read-only, so go through a second handle. Failing is harmless, it only means hashing again next time
+	QFile cacheFile(this->file.fileName());
+	if (!cacheFile.open(QIODevice::ReadWrite | QIODevice::ExistingOnly)) {
+		return;
+	}
+	if (!cacheFile.seek(this->header().sourceOffset + index * sizeof(SourceEntry) + offsetof(SourceEntry, modified))) {
+		return;
+	}
+	const int64_t fields[] = {modified, size};
+	cacheFile.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include <QFile>
+#include <QStringView>
+
+class FGD;
+
+/// A flattened FGD written to disk in a form that can be memory-mapped and queried
+/// without parsing anything. Strings point directly into the mapped file.
+class FGDCache {
+	struct StringRef;
+	struct Header;
+	struct SourceEntry;
+	struct ClassEntry;
+	struct InputOutputEntry;
+	struct KeyValueEntry;
+
+public:
+	struct InputOutput {
+		QStringView name;
+		QStringView type;
+		QStringView description;
+	};
+
+	struct KeyValue {
+		QStringView name;
+		QStringView type;
+		QStringView displayName;
+		QStringView defaultValue;
+		QStringView description;
+	};
+
+	class EntityClass {
+		friend class FGDCache;
+
+	public:
+		[[nodiscard]] QStringView classname() const;
+
+		[[nodiscard]] QStringView description() const;
+
+		[[nodiscard]] qsizetype inputCount() const;
+
+		[[nodiscard]] InputOutput input(qsizetype index) const;
+
+		[[nodiscard]] qsizetype outputCount() const;
+
+		[[nodiscard]] InputOutput output(qsizetype index) const;
+
+		[[nodiscard]] qsizetype keyValueCount() const;
+
+		[[nodiscard]] KeyValue keyValue(qsizetype index) const;
+
+	private:
+		EntityClass(const FGDCache* cache_, const ClassEntry* entry_);
+
+		const FGDCache* cache;
+		const ClassEntry* entry;
+	};
+
+	static constexpr uint32_t VERSION = 2;
+
+	/// Maps the cache for the given FGD, (re)building it first if it's missing, stale, or from an older version
+	[[nodiscard]] static std::unique_ptr<FGDCache> open(const QString& fgdPath, const QString& cacheDirectory);
+
+	/// Flattens a parsed FGD and writes it out as a cache file
+	static bool write(const QString& cachePath, const FGD& fgd);
+
+	FGDCache(const FGDCache& other) = delete;
+	FGDCache& operator=(const FGDCache& other) = delete;
+
+	[[nodiscard]] qsizetype classCount() const;
+
+	[[nodiscard]] EntityClass classAt(qsizetype index) const;
+
+	/// Case-insensitive, like the engine
+	[[nodiscard]] std::optional<EntityClass> findClass(QStringView classname) const;
+
+	/// Size of the mapped cache file in bytes
+	[[nodiscard]] qint64 mappedSize() const;
+
+private:
+	FGDCache() = default;
+
+	/// Maps the file and checks it was written by this version, without touching the FGDs it came from
+	bool map(const QString& cachePath);
+
+	/// Checks that none of the FGDs this cache was built from have changed on disk.
+	/// FGDs that were only touched have their new timestamp written back to the cache
+	[[nodiscard]] bool isUpToDate() const;
+
+	/// Overwrites the timestamp and size stored for a source in the cache file
+	void updateSource(uint32_t index, int64_t modified, int64_t size) const;
+
+	[[nodiscard]] const Header& header() const;
+
+	template<typename T>
+	[[nodiscard]] const T* section(uint32_t offset) const;
+
+	[[nodiscard]] QStringView string(const StringRef& ref) const;
+
+	QFile file;
+	const uchar* data = nullptr;
+	qint64 size = 0;
+};
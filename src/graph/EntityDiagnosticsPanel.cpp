@@ -0,0 +1,67 @@
+#include "EntityDiagnosticsPanel.h"
+
+#include <QHeaderView>
+#include <QLabel>
+#include <QStyle>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "EntityGraphModel.h"
+
+EntityDiagnosticsPanel::EntityDiagnosticsPanel(QWidget* parent)
+		: QDockWidget(tr("Diagnostics"), parent) {
+	this->setObjectName("diagnostics");
+
+	auto* contents = new QWidget(this);
+	auto* layout = new QVBoxLayout(contents);
+	layout->setContentsMargins(0, 0, 0, 0);
+
+	this->diagnosticList = new QTreeWidget(contents);
+	this->diagnosticList->setHeaderLabels({tr("Entity"), tr("Problem")});
+	this->diagnosticList->setRootIsDecorated(false);
+	this->diagnosticList->setUniformRowHeights(true);
+	this->diagnosticList->header()->setSectionResizeMode(1, QHeaderView::Stretch);
+	layout->addWidget(this->diagnosticList, 1);
+
+	this->summary = new QLabel(contents);
+	this->summary->setContentsMargins(4, 2, 4, 2);
+	layout->addWidget(this->summary);
+
+	this->setWidget(contents);
+
+	QObject::connect(this->diagnosticList, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem* item) {
+		Q_EMIT this->entityActivated(item->data(0, Qt::UserRole).toInt());
+	});
+}
+
+void EntityDiagnosticsPanel::setDiagnostics(const QList<EntityValidator::Diagnostic>& diagnostics, const EntityGraphModel& model, qint64 elapsedNs) {
+	this->diagnosticList->clear();
+
+	const auto errorIcon = this->style()->standardIcon(QStyle::SP_MessageBoxCritical);
+	const auto warningIcon = this->style()->standardIcon(QStyle::SP_MessageBoxWarning);
+	int errors = 0;
+	QList<QTreeWidgetItem*> items;
+	items.reserve(diagnostics.size());
+	for (const auto& diagnostic : diagnostics) {
+		const NodeId nodeId = diagnostic.entityId;
+		auto* item = new QTreeWidgetItem({model.nodeExists(nodeId) ? model.node(nodeId).caption : QString::number(diagnostic.entityId), diagnostic.message});
+		item->setData(0, Qt::UserRole, diagnostic.entityId);
+		if (diagnostic.severity == EntityValidator::SEVERITY_ERROR) {
+			item->setIcon(0, errorIcon);
+			errors++;
+		} else {
+			item->setIcon(0, warningIcon);
+		}
+		items.push_back(item);
+	}
+	this->diagnosticList->addTopLevelItems(items);
+	this->diagnosticList->resizeColumnToContents(0);
+
+	const auto warnings = static_cast<int>(diagnostics.size()) - errors;
+	this->summary->setText(tr("%n error(s)", "", errors) + ", " + tr("%n warning(s)", "", warnings) + " " + tr("found in %1 ms.").arg(static_cast<double>(elapsedNs) / 1e6, 0, 'f', 2));
+}
+
+void EntityDiagnosticsPanel::clear() {
+	this->diagnosticList->clear();
+	this->summary->clear();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QDockWidget>
+
+#include "EntityValidator.h"
+
+class QLabel;
+class QTreeWidget;
+
+class EntityGraphModel;
+
+/// Lists what the validator found. Activating a row asks for its entity to be shown
+class EntityDiagnosticsPanel : public QDockWidget {
+	Q_OBJECT;
+
+public:
+	explicit EntityDiagnosticsPanel(QWidget* parent = nullptr);
+
+	/// Entity names come from the model, so the entities have to be loaded into it first
+	void setDiagnostics(const QList<EntityValidator::Diagnostic>& diagnostics, const EntityGraphModel& model, qint64 elapsedNs);
+
+	void clear();
+
+Q_SIGNALS:
+	void entityActivated(int entityId);
+
+private:
+	QTreeWidget* diagnosticList;
+	QLabel* summary;
+};
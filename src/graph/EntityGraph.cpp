@@ -5,9 +5,41 @@
 
 #include <QtNodes/BasicGraphicsScene>
 #include <QtNodes/ConnectionStyle>
+#include <QtNodes/internal/ConnectionGraphicsObject.hpp>
+#include <QtNodes/internal/NodeGraphicsObject.hpp>
+
+#include "../debug/MemoryReport.h"
+
+#include "EntityGraphConnectionLayer.h"
+#include "EntityGraphDiff.h"
+#include "EntityGraphMinimap.h"
+
+namespace {
+
+constexpr int MINIMAP_OFFSET = 12;
+
+/// Roughly the size of a freshly added node, used to keep new nodes from landing on top of old ones
+constexpr QSizeF NEW_NODE_SIZE{160.0, 80.0};
+
+QColor diffColor(EntityGraphDiff::State state) {
+	switch (state) {
+		case EntityGraphDiff::STATE_UNCHANGED:
+			break;
+		case EntityGraphDiff::STATE_ADDED:
+			return {80, 200, 90};
+		case EntityGraphDiff::STATE_REMOVED:
+			return {225, 70, 70};
+		case EntityGraphDiff::STATE_CHANGED:
+			return {235, 180, 50};
+	}
+	return {};
+}
+
+} // namespace
 
 EntityGraph::EntityGraph(QWidget* parent)
-		: QWidget(parent) {
+		: QWidget(parent)
+		, connectionBundling(false) {
 	// Set up some style stuff
 	this->graphView.setStyleSheet(R"(QFrame { border: none; })");
 	QtNodes::ConnectionStyle::setConnectionStyle(R"({ "ConnectionStyle": { "UseDataDefinedColors": true } })");
@@ -28,12 +60,134 @@ EntityGraph::EntityGraph(QWidget* parent)
 	QObject::connect(this->addEntityAction, &QAction::triggered, [&] {
 		// Mouse position in scene coordinates
 		QPointF posView = this->graphView.mapToScene(this->graphView.mapFromGlobal(QCursor::pos()));
+		// Step down until there's room, if something's already under the cursor
+		for (int i = 0; i < 32 && !this->graphModel.nodesInRect({posView, NEW_NODE_SIZE}).isEmpty(); i++) {
+			posView.ry() += NEW_NODE_SIZE.height();
+		}
 		const NodeId newId = this->graphModel.addNode(QString());
 		this->graphModel.setNodeData(newId, NodeRole::Position, posView);
 	});
 	this->graphView.insertAction(this->graphView.actions().front(), this->addEntityAction);
+
+	this->minimap = new EntityGraphMinimap(this->graphModel, this->graphView, &this->graphView);
+
+	this->connectionLayer = new EntityGraphConnectionLayer(*this->graphScene, this->graphModel);
+	this->connectionLayer->setBundling(false);
+	this->connectionLayer->setVisible(false);
+	this->graphScene->addItem(this->connectionLayer);
 }
 
 void EntityGraph::clear() {
 	this->graphModel.clear();
+	this->updateConnectionLayer();
+}
+
+void EntityGraph::centerOnNode(NodeId nodeId) {
+	auto* node = this->graphScene->nodeGraphicsObject(nodeId);
+	if (!node) {
+		return;
+	}
+	this->graphScene->clearSelection();
+	node->setSelected(true);
+	this->graphView.centerOn(node);
+}
+
+void EntityGraph::setMinimapVisible(bool visible) {
+	this->minimap->setVisible(visible);
+}
+
+void EntityGraph::setConnectionBundling(bool bundle) {
+	if (bundle == this->connectionBundling) {
+		return;
+	}
+	this->connectionBundling = bundle;
+	this->updateConnectionLayer();
+
+	// While the layer draws everything, the scene doesn't get an item per connection at all. Hidden ones would
+	// still sit in its index, hold their memory, and recompute their geometry whenever a node moves
+	if (bundle) {
+		QObject::disconnect(&this->graphModel, &QtNodes::AbstractGraphModel::connectionCreated, this->graphScene, &QtNodes::BasicGraphicsScene::onConnectionCreated);
+		for (const auto& connectionId : this->graphModel.allConnections()) {
+			this->graphScene->onConnectionDeleted(connectionId);
+		}
+	} else {
+		for (const auto& connectionId : this->graphModel.allConnections()) {
+			this->graphScene->onConnectionCreated(connectionId);
+			this->updateConnectionItem(connectionId);
+		}
+		QObject::connect(&this->graphModel, &QtNodes::AbstractGraphModel::connectionCreated, this->graphScene, &QtNodes::BasicGraphicsScene::onConnectionCreated);
+	}
+}
+
+#if ENTGRAPH_ENABLE_TRACING
+void EntityGraph::setFrameStatsVisible(bool visible) {
+	this->graphView.setFrameStatsVisible(visible);
+}
+#endif
+
+void EntityGraph::reportMemory(MemoryReport& report) const {
+	this->graphModel.reportMemory(report);
+
+	// Only the items themselves, their private data and cached painting aren't visible from here
+	qint64 nodeItems = 0;
+	qint64 connectionItems = 0;
+	qint64 otherItems = 0;
+	for (const auto* item : this->graphScene->items()) {
+		if (dynamic_cast<const QtNodes::NodeGraphicsObject*>(item)) {
+			nodeItems++;
+		} else if (dynamic_cast<const QtNodes::ConnectionGraphicsObject*>(item)) {
+			connectionItems++;
+		} else {
+			otherItems++;
+		}
+	}
+	report.add("Scene", "Node items", nodeItems * static_cast<qint64>(sizeof(QtNodes::NodeGraphicsObject)), nodeItems);
+	report.add("Scene", "Connection items", connectionItems * static_cast<qint64>(sizeof(QtNodes::ConnectionGraphicsObject)), connectionItems);
+	report.add("Scene", "Other items", otherItems * static_cast<qint64>(sizeof(QGraphicsObject)), otherItems);
+	report.add("Scene", "Bundled connection paths", this->connectionLayer->memoryUsage());
+}
+
+void EntityGraph::resizeEvent(QResizeEvent* event) {
+	QWidget::resizeEvent(event);
+	this->minimap->move(this->graphView.width() - this->minimap->width() - MINIMAP_OFFSET, this->graphView.height() - this->minimap->height() - MINIMAP_OFFSET);
+}
+
+void EntityGraph::showDiff(const EntityGraphDiff& diff, const FGDCache* fgd) {
+	this->graphModel.clear();
+	this->graphModel.loadEntities(diff.getMergedEntities(), fgd);
+
+	// Every output port is one I/O connection from the map, so the output side is enough to find its state
+	QHash<QPair<NodeId, PortIndex>, EntityGraphDiff::State> connectionStates;
+	for (const auto& diffEntity : diff.getEntities()) {
+		const NodeId id = diffEntity.entity.id;
+		if (diffEntity.state != EntityGraphDiff::STATE_UNCHANGED) {
+			this->graphModel.setNodeHighlight(id, diffColor(diffEntity.state));
+		}
+		for (PortIndex i = 0; i < static_cast<PortIndex>(diffEntity.connectionStates.size()); i++) {
+			if (diffEntity.connectionStates[i] != EntityGraphDiff::STATE_UNCHANGED) {
+				connectionStates.insert({id, i}, diffEntity.connectionStates[i]);
+			}
+		}
+	}
+	for (const auto& connectionId : this->graphModel.allConnections()) {
+		const auto state = connectionStates.constFind({connectionId.outNodeId, connectionId.outPortIndex});
+		if (state == connectionStates.constEnd()) {
+			continue;
+		}
+		this->graphModel.setConnectionHighlight(connectionId, diffColor(*state));
+		this->updateConnectionItem(connectionId);
+	}
+	this->updateConnectionLayer();
+}
+
+void EntityGraph::updateConnectionLayer() {
+	this->connectionLayer->setBundling(this->connectionBundling);
+	this->connectionLayer->setVisible(this->connectionBundling || this->graphModel.hasConnectionHighlights());
+}
+
+void EntityGraph::updateConnectionItem(ConnectionId connectionId) {
+	// The layer draws highlighted connections in their color, so QtNodes' item would only be in the way
+	if (auto* connection = this->graphScene->connectionGraphicsObject(connectionId)) {
+		connection->setVisible(!this->graphModel.connectionHighlight(connectionId).isValid());
+	}
 }
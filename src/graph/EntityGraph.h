@@ -2,11 +2,15 @@
 
 #include <QWidget>
 
-#include <QtNodes/GraphicsView>
-
 #include "EntityGraphModel.h"
+#include "EntityGraphView.h"
 
 class QAction;
+class EntityGraphConnectionLayer;
+class EntityGraphDiff;
+class EntityGraphMinimap;
+class FGDCache;
+class MemoryReport;
 
 namespace QtNodes {
 
@@ -30,11 +34,40 @@ public:
 
 	void clear();
 
+	/// Loads the merged revisions of a diff, coloring whatever was added, removed, or changed
+	void showDiff(const EntityGraphDiff& diff, const FGDCache* fgd = nullptr);
+
+	/// Scrolls the node into the middle of the view and selects it
+	void centerOnNode(NodeId nodeId);
+
+	void setMinimapVisible(bool visible);
+
+	/// Draws connections bundled and batched into one layer instead of as separate items
+	void setConnectionBundling(bool bundle);
+
+	/// Adds the model and the scene items drawing it
+	void reportMemory(MemoryReport& report) const;
+
+#if ENTGRAPH_ENABLE_TRACING
+	void setFrameStatsVisible(bool visible);
+#endif
+
+protected:
+	void resizeEvent(QResizeEvent* event) override;
+
 private:
 	EntityGraphModel graphModel;
 
 	QtNodes::BasicGraphicsScene* graphScene;
-	QtNodes::GraphicsView graphView;
+	EntityGraphView graphView;
+	EntityGraphMinimap* minimap;
+	EntityGraphConnectionLayer* connectionLayer;
+	bool connectionBundling;
 
 	QAction* addEntityAction;
+
+	/// Shows the layer if it has anything to draw, which is only highlighted connections while not bundling
+	void updateConnectionLayer();
+
+	void updateConnectionItem(ConnectionId connectionId);
 };
@@ -0,0 +1,385 @@
+#include "EntityGraphConnectionLayer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include <QtNodes/BasicGraphicsScene>
+#include <QtNodes/internal/AbstractNodeGeometry.hpp>
+#include <QtNodes/internal/NodeGraphicsObject.hpp>
+
+#include "../debug/MemoryReport.h"
+#include "../debug/Trace.h"
+#include "EntityGraphModel.h"
+
+namespace {
+
+/// Scene units per side of a tile. Big enough to keep the tile count low, small enough to cull well
+constexpr qreal TILE_SIZE = 2048.0;
+
+/// Sources with at least this many targets get a trunk
+constexpr int FAN_OUT_BUNDLE_MIN = 3;
+
+/// How far right of its node a trunk starts
+constexpr qreal TRUNK_STUB = 24.0;
+
+constexpr qreal MIN_CURVE_OFFSET = 40.0;
+
+/// Below this zoom level, lines are drawn one pixel wide without antialiasing
+constexpr qreal DETAIL_LOD = 0.5;
+
+constexpr std::array<qreal, 2> PATH_WIDTHS{2.0, 4.0};
+
+/// Highlighted connections are drawn as wide as trunks so they stand out
+constexpr qreal COLORED_PATH_WIDTH = PATH_WIDTHS.back();
+
+const std::array<QColor, EntityGraphConnectionLayer::PALETTE_SIZE>& palette() {
+	static const auto colors = [] {
+		std::array<QColor, EntityGraphConnectionLayer::PALETTE_SIZE> out;
+		for (int i = 0; i < EntityGraphConnectionLayer::PALETTE_SIZE; i++) {
+			out[i] = QColor::fromHsvF(static_cast<float>(i) / EntityGraphConnectionLayer::PALETTE_SIZE, 0.55f, 0.95f);
+		}
+		return out;
+	}();
+	return colors;
+}
+
+/// Outputs with the same name get the same color everywhere
+int paletteIndex(const QString& output) {
+	return static_cast<int>(qHash(output.toLower()) % EntityGraphConnectionLayer::PALETTE_SIZE);
+}
+
+QPoint tileOf(const QPointF& point) {
+	return {static_cast<int>(std::floor(point.x() / TILE_SIZE)), static_cast<int>(std::floor(point.y() / TILE_SIZE))};
+}
+
+void addCurve(QPainterPath& path, const QPointF& from, const QPointF& to) {
+	const auto offset = std::max(std::abs(to.x() - from.x()) * 0.5, MIN_CURVE_OFFSET);
+	path.moveTo(from);
+	path.cubicTo(from + QPointF(offset, 0), to - QPointF(offset, 0), to);
+}
+
+} // namespace
+
+EntityGraphConnectionLayer::EntityGraphConnectionLayer(QtNodes::BasicGraphicsScene& scene_, const EntityGraphModel& model_)
+		: QGraphicsObject()
+		, scene(scene_)
+		, model(model_)
+		, bundling(true)
+		, dirty(true)
+		, dirtyAll(true) {
+	this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+	// Under the nodes, like the connections it replaces
+	this->setZValue(-1.0);
+
+	// Connections are drawn from their source's tiles, so that's the node that needs redrawing when one comes or goes
+	QObject::connect(&this->model, &EntityGraphModel::connectionCreated, this, [this](ConnectionId connectionId) {
+		this->markNodeDirty(connectionId.outNodeId);
+	});
+	QObject::connect(&this->model, &EntityGraphModel::connectionDeleted, this, [this](ConnectionId connectionId) {
+		this->markNodeDirty(connectionId.outNodeId);
+	});
+	QObject::connect(&this->model, &EntityGraphModel::connectionHighlightUpdated, this, [this](ConnectionId connectionId) {
+		this->markNodeDirty(connectionId.outNodeId);
+	});
+	QObject::connect(&this->model, &EntityGraphModel::nodeDeleted, this, &EntityGraphConnectionLayer::markNodeDirty);
+	QObject::connect(&this->model, &EntityGraphModel::nodeUpdated, this, &EntityGraphConnectionLayer::markNodeDirty);
+	QObject::connect(&this->model, &EntityGraphModel::nodePositionUpdated, this, &EntityGraphConnectionLayer::markNodeDirty);
+}
+
+QRectF EntityGraphConnectionLayer::boundingRect() const {
+	// While hidden there's nothing to draw, so the rebuild waits until the layer is shown again
+	if (this->dirty && this->isVisible()) {
+		this->rebuild();
+	}
+	return this->bounds;
+}
+
+void EntityGraphConnectionLayer::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* /*widget*/) {
+	ENTGRAPH_TRACE_SCOPE("EntityGraphConnectionLayer::paint", "paint");
+	if (this->dirty) {
+		this->rebuild();
+	}
+
+	const auto detailed = option->levelOfDetailFromTransform(painter->worldTransform()) >= DETAIL_LOD;
+	painter->setRenderHint(QPainter::Antialiasing, detailed);
+	painter->setBrush(Qt::NoBrush);
+
+	std::array<std::array<QPen, PALETTE_SIZE>, PATH_WIDTH_COUNT> pens;
+	for (int width = 0; width < PATH_WIDTH_COUNT; width++) {
+		for (int color = 0; color < PALETTE_SIZE; color++) {
+			auto& pen = pens[width][color];
+			pen = QPen(palette()[color], detailed ? PATH_WIDTHS[width] : 0.0);
+			pen.setCosmetic(!detailed);
+		}
+	}
+
+	for (const auto& tile : this->tiles) {
+		if (!tile.bounds.intersects(option->exposedRect)) {
+			continue;
+		}
+		for (int width = 0; width < PATH_WIDTH_COUNT; width++) {
+			for (int color = 0; color < PALETTE_SIZE; color++) {
+				if (const auto& path = tile.paths[width][color]; !path.isEmpty()) {
+					painter->setPen(pens[width][color]);
+					painter->drawPath(path);
+				}
+			}
+		}
+		// On top, so the colored ones aren't hidden under everything else
+		for (const auto& [color, path] : tile.colored.asKeyValueRange()) {
+			QPen pen(QColor::fromRgba(color), detailed ? COLORED_PATH_WIDTH : 0.0);
+			pen.setCosmetic(!detailed);
+			painter->setPen(pen);
+			painter->drawPath(path);
+		}
+	}
+}
+
+void EntityGraphConnectionLayer::markDirty() {
+	this->dirtyAll = true;
+	this->dirtyNodes.clear();
+	this->scheduleRebuild();
+}
+
+void EntityGraphConnectionLayer::markNodeDirty(NodeId nodeId) {
+	if (!this->dirtyAll) {
+		this->dirtyNodes.insert(nodeId);
+		// Past this point, most tiles are going to be redrawn anyway
+		if (this->dirtyNodes.size() > this->tilesBySource.size() / 2) {
+			this->dirtyAll = true;
+			this->dirtyNodes.clear();
+		}
+	}
+	this->scheduleRebuild();
+}
+
+void EntityGraphConnectionLayer::setBundling(bool bundling_) {
+	if (this->bundling == bundling_) {
+		return;
+	}
+	this->bundling = bundling_;
+	this->markDirty();
+}
+
+qint64 EntityGraphConnectionLayer::memoryUsage() const {
+	// Only what's been built so far, the tiles aren't rebuilt just to be measured
+	qint64 bytes = MemoryUsage::heap(this->tiles);
+	for (const auto& tile : this->tiles) {
+		for (const auto& paths : tile.paths) {
+			for (const auto& path : paths) {
+				bytes += static_cast<qint64>(path.elementCount()) * static_cast<qint64>(sizeof(QPainterPath::Element));
+			}
+		}
+		bytes += MemoryUsage::heap(tile.colored) + MemoryUsage::heap(tile.sources);
+		for (const auto& path : tile.colored) {
+			bytes += static_cast<qint64>(path.elementCount()) * static_cast<qint64>(sizeof(QPainterPath::Element));
+		}
+	}
+	bytes += MemoryUsage::heap(this->tilesBySource);
+	for (const auto& tileIds : this->tilesBySource) {
+		bytes += MemoryUsage::heap(tileIds);
+	}
+	return bytes;
+}
+
+void EntityGraphConnectionLayer::scheduleRebuild() {
+	if (this->dirty) {
+		return;
+	}
+	// This asks for the old bounds, so it has to happen before they go stale, and only once,
+	// or every change made while loading a map would rebuild everything through boundingRect()
+	this->prepareGeometryChange();
+	this->dirty = true;
+	this->update();
+}
+
+QVariant EntityGraphConnectionLayer::itemChange(GraphicsItemChange change, const QVariant& value) {
+	if (change == QGraphicsItem::ItemVisibleHasChanged && value.toBool() && this->dirty) {
+		// Anything that changed while hidden left the scene's copy of our bounds stale
+		this->prepareGeometryChange();
+		this->update();
+	}
+	return QGraphicsObject::itemChange(change, value);
+}
+
+void EntityGraphConnectionLayer::rebuild() const {
+	ENTGRAPH_TRACE_SCOPE("EntityGraphConnectionLayer::rebuild", "layout");
+	this->dirty = false;
+
+	// Nodes whose outgoing connections are drawn again everywhere: the ones that changed, and whatever connects
+	// into them, since a trunk depends on where all of its targets are
+	QSet<NodeId> sources;
+	// Tiles those connections were in, which are cleared and drawn again from scratch
+	QSet<QPoint> staleTiles;
+	// Nodes that also have connections in the stale tiles, which only need the parts inside them drawn again
+	QSet<NodeId> neighbors;
+	const bool rebuildAll = this->dirtyAll;
+	if (rebuildAll) {
+		this->tiles.clear();
+		this->tilesBySource.clear();
+	} else {
+		sources = this->dirtyNodes;
+		for (const auto& connectionId : this->model.allConnections()) {
+			if (this->dirtyNodes.contains(connectionId.inNodeId)) {
+				sources.insert(connectionId.outNodeId);
+			}
+		}
+		for (const auto source : std::as_const(sources)) {
+			if (const auto it = this->tilesBySource.find(source); it != this->tilesBySource.end()) {
+				staleTiles.unite(*it);
+				this->tilesBySource.erase(it);
+			}
+		}
+		for (const auto& tileId : std::as_const(staleTiles)) {
+			auto& tile = this->tiles[tileId];
+			neighbors.unite(tile.sources);
+			tile = Tile{};
+		}
+		neighbors.subtract(sources);
+	}
+	this->dirtyAll = false;
+	this->dirtyNodes.clear();
+
+	const auto portPosition = [this](NodeId nodeId, PortType portType, PortIndex portIndex) -> std::optional<QPointF> {
+		const auto* node = this->scene.nodeGraphicsObject(nodeId);
+		if (!node) {
+			return std::nullopt;
+		}
+		return this->scene.nodeGeometry().portScenePosition(nodeId, portType, portIndex, node->sceneTransform());
+	};
+
+	// Every connection between the same two nodes becomes one edge between the middles of their ports.
+	// Connections with a color of their own are kept apart, so the color isn't lost in the merge
+	struct Edge {
+		QPointF from;
+		QPointF to;
+		int count = 0;
+		int color = 0;
+	};
+	QHash<NodeId, QHash<QPair<NodeId, QRgb>, Edge>> edgesBySource;
+	for (const auto& connectionId : this->model.allConnections()) {
+		if (!rebuildAll && !sources.contains(connectionId.outNodeId) && !neighbors.contains(connectionId.outNodeId)) {
+			continue;
+		}
+		const auto from = portPosition(connectionId.outNodeId, PortType::Out, connectionId.outPortIndex);
+		const auto to = portPosition(connectionId.inNodeId, PortType::In, connectionId.inPortIndex);
+		if (!from || !to) {
+			continue;
+		}
+		const auto highlight = this->model.connectionHighlight(connectionId);
+		if (!this->bundling && !highlight.isValid()) {
+			continue;
+		}
+		auto& edge = edgesBySource[connectionId.outNodeId][{connectionId.inNodeId, highlight.isValid() ? highlight.rgba() : 0}];
+		if (edge.count == 0) {
+			edge.color = paletteIndex(this->model.portData(connectionId.outNodeId, PortType::Out, connectionId.outPortIndex, PortRole::Caption).toString());
+		}
+		edge.from += *from;
+		edge.to += *to;
+		edge.count++;
+	}
+
+	QSet<QPoint> touchedTiles = staleTiles;
+	for (auto [source, targetEdges] : edgesBySource.asKeyValueRange()) {
+		const auto onlyStale = neighbors.contains(source);
+		const auto tileFor = [&, source](const QPointF& start) -> Tile* {
+			const auto tileId = tileOf(start);
+			if (onlyStale && !staleTiles.contains(tileId)) {
+				return nullptr;
+			}
+			auto& tile = this->tiles[tileId];
+			tile.sources.insert(source);
+			this->tilesBySource[source].insert(tileId);
+			touchedTiles.insert(tileId);
+			return &tile;
+		};
+		const auto addCurveTo = [&](PathWidth width, int color, const QPointF& from, const QPointF& to) {
+			if (auto* tile = tileFor(from)) {
+				addCurve(tile->paths[width][color], from, to);
+			}
+		};
+
+		QList<Edge> sourceEdges;
+		for (auto [key, edge] : targetEdges.asKeyValueRange()) {
+			edge.from /= edge.count;
+			edge.to /= edge.count;
+			if (const auto color = key.second) {
+				if (auto* tile = tileFor(edge.from)) {
+					addCurve(tile->colored[color], edge.from, edge.to);
+				}
+			} else {
+				sourceEdges.push_back(edge);
+			}
+		}
+		if (sourceEdges.isEmpty()) {
+			continue;
+		}
+		if (sourceEdges.size() < FAN_OUT_BUNDLE_MIN) {
+			for (const auto& edge : sourceEdges) {
+				addCurveTo(PATH_BRANCH, edge.color, edge.from, edge.to);
+			}
+			continue;
+		}
+
+		// One trunk from just right of the source to the middle of its targets, then a branch to each target.
+		// The trunk takes the color most of the branches have
+		qreal anchorX = sourceEdges.front().from.x();
+		QPointF fromCenter, toCenter;
+		qreal nearestTargetX = sourceEdges.front().to.x();
+		std::array<int, PALETTE_SIZE> colorCounts{};
+		for (const auto& edge : sourceEdges) {
+			anchorX = std::max(anchorX, edge.from.x());
+			fromCenter += edge.from;
+			toCenter += edge.to;
+			nearestTargetX = std::min(nearestTargetX, edge.to.x());
+			colorCounts[edge.color] += edge.count;
+		}
+		fromCenter /= sourceEdges.size();
+		toCenter /= sourceEdges.size();
+		const QPointF anchor{anchorX + TRUNK_STUB, fromCenter.y()};
+		const QPointF split{std::max(anchor.x() + TRUNK_STUB, anchor.x() + (nearestTargetX - anchor.x()) * 0.5), toCenter.y()};
+		const auto trunkColor = static_cast<int>(std::max_element(colorCounts.begin(), colorCounts.end()) - colorCounts.begin());
+
+		addCurveTo(PATH_TRUNK, trunkColor, anchor, split);
+		for (const auto& edge : sourceEdges) {
+			if (auto* tile = tileFor(edge.from)) {
+				auto& stub = tile->paths[PATH_BRANCH][edge.color];
+				stub.moveTo(edge.from);
+				stub.lineTo(anchor);
+			}
+			addCurveTo(PATH_BRANCH, edge.color, split, edge.to);
+		}
+	}
+
+	for (const auto& tileId : std::as_const(touchedTiles)) {
+		const auto it = this->tiles.find(tileId);
+		if (it == this->tiles.end()) {
+			continue;
+		}
+		if (it->sources.isEmpty()) {
+			this->tiles.erase(it);
+			continue;
+		}
+		it->bounds = QRectF();
+		for (const auto& widthPaths : it->paths) {
+			for (const auto& path : widthPaths) {
+				if (!path.isEmpty()) {
+					it->bounds = it->bounds.united(path.controlPointRect());
+				}
+			}
+		}
+		for (const auto& path : it->colored) {
+			it->bounds = it->bounds.united(path.controlPointRect());
+		}
+		// Leave room for the pen
+		it->bounds.adjust(-PATH_WIDTHS.back(), -PATH_WIDTHS.back(), PATH_WIDTHS.back(), PATH_WIDTHS.back());
+	}
+	this->bounds = QRectF();
+	for (const auto& tile : std::as_const(this->tiles)) {
+		this->bounds = this->bounds.united(tile.bounds);
+	}
+}
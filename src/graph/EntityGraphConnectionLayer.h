@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+
+#include <QGraphicsObject>
+#include <QHash>
+#include <QPainterPath>
+#include <QPen>
+#include <QPoint>
+#include <QSet>
+
+#include "EntityGraphModel.h"
+
+namespace QtNodes {
+
+class BasicGraphicsScene;
+
+} // namespace QtNodes
+
+/// Draws every connection in the graph as one scene item, in place of QtNodes' item per connection.
+/// Connections between the same pair of nodes are merged, and entities firing at several targets
+/// get one trunk that splits near the targets. The result is baked into a few paths per scene tile
+/// and color, so a frame costs a handful of draw calls for the tiles on screen however many
+/// connections there are. The paths are rebuilt lazily, at most once per frame, and only in the tiles
+/// holding connections of the nodes that changed. Highlighted connections are drawn on their own,
+/// on top, in their highlight color. With bundling off, those are the only ones drawn.
+class EntityGraphConnectionLayer : public QGraphicsObject {
+	Q_OBJECT;
+
+public:
+	static constexpr int PALETTE_SIZE = 12;
+
+	EntityGraphConnectionLayer(QtNodes::BasicGraphicsScene& scene_, const EntityGraphModel& model_);
+
+	[[nodiscard]] QRectF boundingRect() const override;
+
+	void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+	/// Redraws every connection on the next paint
+	void markDirty();
+
+	/// Redraws only the tiles holding connections to or from the node on the next paint
+	void markNodeDirty(NodeId nodeId);
+
+	/// Whether to draw every connection, or only the highlighted ones over QtNodes' items
+	void setBundling(bool bundling_);
+
+	/// Approximate heap bytes held by the baked paths
+	[[nodiscard]] qint64 memoryUsage() const;
+
+protected:
+	QVariant itemChange(GraphicsItemChange change, const QVariant& value) override;
+
+private:
+	enum PathWidth {
+		PATH_BRANCH = 0,
+		PATH_TRUNK,
+		PATH_WIDTH_COUNT,
+	};
+
+	struct Tile {
+		std::array<std::array<QPainterPath, PALETTE_SIZE>, PATH_WIDTH_COUNT> paths;
+		/// Highlighted connections, by highlight color
+		QHash<QRgb, QPainterPath> colored;
+		/// Nodes with outgoing connections that start in this tile
+		QSet<NodeId> sources;
+		QRectF bounds;
+	};
+
+	QtNodes::BasicGraphicsScene& scene;
+	const EntityGraphModel& model;
+	bool bundling;
+
+	mutable QHash<QPoint, Tile> tiles;
+	/// Tiles each node's outgoing connections start in
+	mutable QHash<NodeId, QSet<QPoint>> tilesBySource;
+	mutable QRectF bounds;
+	mutable bool dirty;
+	/// Whether every tile is redrawn, or only the ones holding connections of dirtyNodes
+	mutable bool dirtyAll;
+	mutable QSet<NodeId> dirtyNodes;
+
+	void scheduleRebuild();
+
+	void rebuild() const;
+};
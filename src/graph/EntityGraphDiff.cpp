@@ -0,0 +1,196 @@
+#include "EntityGraphDiff.h"
+
+#include <algorithm>
+
+#include <QHash>
+#include <QSet>
+
+#include "../debug/Trace.h"
+
+namespace {
+
+size_t hashConnection(const EntityConnectionKV& connection) {
+	return qHashMulti(0, connection.output, connection.targetname, connection.input, connection.parameter, connection.delay, connection.fireAmount);
+}
+
+bool connectionsEqual(const EntityConnectionKV& lhs, const EntityConnectionKV& rhs) {
+	return lhs.output == rhs.output && lhs.targetname == rhs.targetname && lhs.input == rhs.input && lhs.parameter == rhs.parameter && lhs.delay == rhs.delay && lhs.fireAmount == rhs.fireAmount;
+}
+
+/// Everything but the id, which is what we fall back to matching on when the ids don't line up
+size_t hashEntity(const EntityKV& entity) {
+	auto hash = qHashMulti(0, entity.classname, entity.targetname);
+	for (const auto& connection : entity.connections) {
+		hash = qHashMulti(hash, hashConnection(connection));
+	}
+	return hash;
+}
+
+bool entitiesEqual(const EntityKV& lhs, const EntityKV& rhs) {
+	return lhs.classname == rhs.classname && lhs.targetname == rhs.targetname && std::equal(lhs.connections.begin(), lhs.connections.end(), rhs.connections.begin(), rhs.connections.end(), &connectionsEqual);
+}
+
+/// Takes the first index in the bucket for this hash that the predicate accepts, or returns -1
+template<typename Pred>
+qsizetype takeMatch(QHash<size_t, QList<qsizetype>>& buckets, size_t hash, Pred pred) {
+	const auto it = buckets.find(hash);
+	if (it == buckets.end()) {
+		return -1;
+	}
+	for (qsizetype i = 0; i < it->size(); i++) {
+		if (const auto index = it->at(i); pred(index)) {
+			it->removeAt(i);
+			if (it->isEmpty()) {
+				buckets.erase(it);
+			}
+			return index;
+		}
+	}
+	return -1;
+}
+
+} // namespace
+
+EntityGraphDiff::EntityGraphDiff(const QList<EntityKV>& oldEntities, const QList<EntityKV>& newEntities) {
+	ENTGRAPH_TRACE_SCOPE("EntityGraphDiff::EntityGraphDiff", "model");
+	QList<qsizetype> oldMatchOfNew(newEntities.size(), -1);
+	QList<bool> oldMatched(oldEntities.size(), false);
+
+	// Ids are only trusted while the class stays the same, Hammer happily reuses the ids of deleted entities.
+	// Entities expanded from instances are numbered in whatever order they were expanded, so they're
+	// matched by where they came from instead
+	QHash<int, qsizetype> oldIndexById;
+	QHash<QString, qsizetype> oldIndexByInstanceKey;
+	oldIndexById.reserve(oldEntities.size());
+	for (qsizetype i = 0; i < oldEntities.size(); i++) {
+		const auto& entity = oldEntities[i];
+		if (entity.instanceKey.isEmpty() && !oldIndexById.contains(entity.id)) {
+			oldIndexById.insert(entity.id, i);
+		} else if (!entity.instanceKey.isEmpty() && !oldIndexByInstanceKey.contains(entity.instanceKey)) {
+			oldIndexByInstanceKey.insert(entity.instanceKey, i);
+		}
+	}
+	for (qsizetype i = 0; i < newEntities.size(); i++) {
+		const auto& entity = newEntities[i];
+		const auto oldIndex = entity.instanceKey.isEmpty() ? oldIndexById.value(entity.id, -1) : oldIndexByInstanceKey.value(entity.instanceKey, -1);
+		if (oldIndex < 0 || oldMatched[oldIndex] || oldEntities[oldIndex].classname.compare(entity.classname, Qt::CaseInsensitive) != 0) {
+			continue;
+		}
+		oldMatchOfNew[i] = oldIndex;
+		oldMatched[oldIndex] = true;
+	}
+
+	// Whatever is left is matched by content, which catches entities that were renumbered
+	QHash<size_t, QList<qsizetype>> unmatchedOldByHash;
+	for (qsizetype i = 0; i < oldEntities.size(); i++) {
+		if (!oldMatched[i]) {
+			unmatchedOldByHash[hashEntity(oldEntities[i])].push_back(i);
+		}
+	}
+	for (qsizetype i = 0; i < newEntities.size() && !unmatchedOldByHash.isEmpty(); i++) {
+		if (oldMatchOfNew[i] >= 0) {
+			continue;
+		}
+		const auto match = takeMatch(unmatchedOldByHash, hashEntity(newEntities[i]), [&](qsizetype oldIndex) {
+			return entitiesEqual(oldEntities[oldIndex], newEntities[i]);
+		});
+		if (match >= 0) {
+			oldMatchOfNew[i] = match;
+			oldMatched[match] = true;
+		}
+	}
+
+	// Removed entities end up in the same graph as the newer revision, so their ids can't clash with it
+	int nextId = 1;
+	for (const auto& entity : oldEntities) {
+		nextId = std::max(nextId, entity.id + 1);
+	}
+	QSet<int> newIds;
+	newIds.reserve(newEntities.size());
+	for (const auto& entity : newEntities) {
+		nextId = std::max(nextId, entity.id + 1);
+		newIds.insert(entity.id);
+	}
+
+	this->entities.reserve(newEntities.size() + oldEntities.size());
+	for (qsizetype i = 0; i < newEntities.size(); i++) {
+		const auto& entity = newEntities[i];
+
+		DiffEntity diffEntity{.entity = entity, .state = STATE_ADDED};
+		if (oldMatchOfNew[i] < 0) {
+			diffEntity.connectionStates.fill(STATE_ADDED, entity.connections.size());
+			this->entities.push_back(std::move(diffEntity));
+			continue;
+		}
+		const auto& oldEntity = oldEntities[oldMatchOfNew[i]];
+
+		// Connections have no identity of their own, so pair up identical ones and call the rest added or removed
+		QHash<size_t, QList<qsizetype>> oldConnectionsByHash;
+		for (qsizetype j = 0; j < oldEntity.connections.size(); j++) {
+			oldConnectionsByHash[hashConnection(oldEntity.connections[j])].push_back(j);
+		}
+		QList<bool> oldConnectionMatched(oldEntity.connections.size(), false);
+		bool changed = oldEntity.classname != entity.classname || oldEntity.targetname != entity.targetname;
+		diffEntity.connectionStates.reserve(entity.connections.size());
+		for (const auto& connection : entity.connections) {
+			const auto match = takeMatch(oldConnectionsByHash, hashConnection(connection), [&](qsizetype oldIndex) {
+				return connectionsEqual(oldEntity.connections[oldIndex], connection);
+			});
+			if (match >= 0) {
+				oldConnectionMatched[match] = true;
+				diffEntity.connectionStates.push_back(STATE_UNCHANGED);
+			} else {
+				diffEntity.connectionStates.push_back(STATE_ADDED);
+				changed = true;
+			}
+		}
+		for (qsizetype j = 0; j < oldEntity.connections.size(); j++) {
+			if (!oldConnectionMatched[j]) {
+				diffEntity.entity.connections.push_back(oldEntity.connections[j]);
+				diffEntity.connectionStates.push_back(STATE_REMOVED);
+				changed = true;
+			}
+		}
+		diffEntity.state = changed ? STATE_CHANGED : STATE_UNCHANGED;
+		this->entities.push_back(std::move(diffEntity));
+	}
+
+	for (qsizetype i = 0; i < oldEntities.size(); i++) {
+		if (oldMatched[i]) {
+			continue;
+		}
+		DiffEntity diffEntity{.entity = oldEntities[i], .state = STATE_REMOVED};
+		if (newIds.contains(diffEntity.entity.id)) {
+			diffEntity.entity.id = nextId++;
+		}
+		diffEntity.connectionStates.fill(STATE_REMOVED, diffEntity.entity.connections.size());
+		this->entities.push_back(std::move(diffEntity));
+	}
+}
+
+const QList<EntityGraphDiff::DiffEntity>& EntityGraphDiff::getEntities() const {
+	return this->entities;
+}
+
+QList<EntityKV> EntityGraphDiff::getMergedEntities() const {
+	QList<EntityKV> out;
+	out.reserve(this->entities.size());
+	for (const auto& diffEntity : this->entities) {
+		out.push_back(diffEntity.entity);
+	}
+	return out;
+}
+
+int EntityGraphDiff::count(State state) const {
+	return static_cast<int>(std::count_if(this->entities.begin(), this->entities.end(), [state](const DiffEntity& diffEntity) {
+		return diffEntity.state == state;
+	}));
+}
+
+int EntityGraphDiff::connectionCount(State state) const {
+	int total = 0;
+	for (const auto& diffEntity : this->entities) {
+		total += static_cast<int>(diffEntity.connectionStates.count(state));
+	}
+	return total;
+}
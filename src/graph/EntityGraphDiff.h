@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QList>
+
+#include "../wrapper/VMFWrapper.h"
+
+/// Structural diff between the entity I/O of two revisions of a map.
+/// Entities are paired up by id first (or by EntityKV::instanceKey if they came from an instance),
+/// then by a hash of their contents, so entities that were renumbered (or come from a BSP without
+/// hammer ids) still match. Everything is hashed once,
+/// so the whole diff is linear in the number of entities and connections.
+class EntityGraphDiff {
+public:
+	enum State {
+		STATE_UNCHANGED = 0,
+		STATE_ADDED,
+		STATE_REMOVED,
+		STATE_CHANGED,
+	};
+
+	struct DiffEntity {
+		/// The newer version of the entity, or the older one if it was removed.
+		/// Removed connections are appended after the ones that still exist
+		EntityKV entity;
+		State state;
+		/// Same order as entity.connections
+		QList<State> connectionStates;
+	};
+
+	EntityGraphDiff(const QList<EntityKV>& oldEntities, const QList<EntityKV>& newEntities);
+
+	/// Every entity from the newer revision, followed by the entities that were removed.
+	/// Removed entities get new ids if theirs are taken by something in the newer revision
+	[[nodiscard]] const QList<DiffEntity>& getEntities() const;
+
+	/// The entities alone, ready to be loaded into a graph
+	[[nodiscard]] QList<EntityKV> getMergedEntities() const;
+
+	[[nodiscard]] int count(State state) const;
+
+	[[nodiscard]] int connectionCount(State state) const;
+
+private:
+	QList<DiffEntity> entities;
+};
@@ -0,0 +1,373 @@
+#include "EntityGraphExporter.h"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+#include <QIODevice>
+#include <QSaveFile>
+
+#include "../debug/Trace.h"
+#include "EntityGraphModel.h"
+
+namespace {
+
+/// Bytes collected before they're handed to the device
+constexpr qsizetype WRITE_BUFFER_SIZE = 64 * 1024;
+
+enum class Escape {
+	DOT,
+	XML,
+	JSON,
+};
+
+/// Collects output in a fixed buffer and hands it to the device in large writes.
+/// Strings are escaped and encoded to UTF-8 as they're copied in, so nothing is allocated per string
+class BufferedWriter {
+public:
+	explicit BufferedWriter(QIODevice& device_)
+			: device(device_) {}
+
+	BufferedWriter(const BufferedWriter& other) = delete;
+	BufferedWriter& operator=(const BufferedWriter& other) = delete;
+
+	void write(char c) {
+		if (this->used == WRITE_BUFFER_SIZE) {
+			this->flush();
+		}
+		this->buffer[this->used++] = c;
+	}
+
+	void write(std::string_view text) {
+		if (static_cast<qsizetype>(text.size()) > WRITE_BUFFER_SIZE - this->used) {
+			this->flush();
+			if (static_cast<qsizetype>(text.size()) > WRITE_BUFFER_SIZE) {
+				this->writeToDevice(text.data(), static_cast<qsizetype>(text.size()));
+				return;
+			}
+		}
+		std::memcpy(this->buffer.data() + this->used, text.data(), text.size());
+		this->used += static_cast<qsizetype>(text.size());
+	}
+
+	template<typename T>
+	void writeNumber(T value) {
+		if constexpr (std::is_floating_point_v<T>) {
+			// None of the formats have a way to spell these
+			if (!std::isfinite(value)) {
+				value = 0;
+			}
+		}
+		std::array<char, 32> digits;
+		const auto [end, error] = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+		this->write(std::string_view{digits.data(), end});
+	}
+
+	void writeEscaped(QStringView text, Escape escape) {
+		for (qsizetype i = 0; i < text.size(); i++) {
+			char32_t c = text[i].unicode();
+			if (QChar::isHighSurrogate(c) && i + 1 < text.size() && text[i + 1].isLowSurrogate()) {
+				c = QChar::surrogateToUcs4(text[i], text[i + 1]);
+				i++;
+			} else if (QChar::isSurrogate(c)) {
+				c = QChar::ReplacementCharacter;
+			}
+
+			if (c >= 0x80) {
+				this->writeUtf8(c);
+				continue;
+			}
+			switch (escape) {
+				case Escape::DOT:
+					this->writeDotEscaped(static_cast<char>(c));
+					break;
+				case Escape::XML:
+					this->writeXmlEscaped(static_cast<char>(c));
+					break;
+				case Escape::JSON:
+					this->writeJsonEscaped(static_cast<char>(c));
+					break;
+			}
+		}
+	}
+
+	/// Writes out whatever is still buffered. Returns false if any write to the device failed
+	bool finish() {
+		this->flush();
+		return !this->failed;
+	}
+
+private:
+	QIODevice& device;
+	std::array<char, WRITE_BUFFER_SIZE> buffer;
+	qsizetype used = 0;
+	bool failed = false;
+
+	void flush() {
+		this->writeToDevice(this->buffer.data(), this->used);
+		this->used = 0;
+	}
+
+	void writeToDevice(const char* data, qsizetype size) {
+		if (size > 0 && !this->failed) {
+			this->failed = this->device.write(data, size) != size;
+		}
+	}
+
+	void writeUtf8(char32_t c) {
+		if (c < 0x800) {
+			this->write(static_cast<char>(0xc0 | (c >> 6)));
+		} else if (c < 0x10000) {
+			this->write(static_cast<char>(0xe0 | (c >> 12)));
+			this->write(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+		} else {
+			this->write(static_cast<char>(0xf0 | (c >> 18)));
+			this->write(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+			this->write(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+		}
+		this->write(static_cast<char>(0x80 | (c & 0x3f)));
+	}
+
+	void writeDotEscaped(char c) {
+		switch (c) {
+			case '"':
+				this->write("\\\"");
+				break;
+			case '\\':
+				this->write("\\\\");
+				break;
+			case '\n':
+				this->write("\\n");
+				break;
+			default:
+				if (c >= 0x20) {
+					this->write(c);
+				}
+				break;
+		}
+	}
+
+	void writeXmlEscaped(char c) {
+		switch (c) {
+			case '&':
+				this->write("&amp;");
+				break;
+			case '<':
+				this->write("&lt;");
+				break;
+			case '>':
+				this->write("&gt;");
+				break;
+			case '"':
+				this->write("&quot;");
+				break;
+			case '\'':
+				this->write("&apos;");
+				break;
+			default:
+				// Other control characters aren't allowed in XML 1.0 at all
+				if (c >= 0x20 || c == '\t' || c == '\n' || c == '\r') {
+					this->write(c);
+				}
+				break;
+		}
+	}
+
+	void writeJsonEscaped(char c) {
+		switch (c) {
+			case '"':
+				this->write("\\\"");
+				break;
+			case '\\':
+				this->write("\\\\");
+				break;
+			case '\n':
+				this->write("\\n");
+				break;
+			case '\r':
+				this->write("\\r");
+				break;
+			case '\t':
+				this->write("\\t");
+				break;
+			default:
+				if (c >= 0x20) {
+					this->write(c);
+				} else {
+					constexpr std::string_view HEX = "0123456789abcdef";
+					this->write("\\u00");
+					this->write(HEX[c >> 4]);
+					this->write(HEX[c & 0xf]);
+				}
+				break;
+		}
+	}
+};
+
+/// What the model keeps about a connection, looked up from the ports at either end
+struct Edge {
+	ConnectionId id;
+	const EntityGraphModel::NodePortOutput& output;
+	QStringView input;
+};
+
+template<typename Callback>
+void forEachEdge(const EntityGraphModel& model, Callback&& callback) {
+	for (const auto& connectionId : model.allConnections()) {
+		const auto& source = model.node(connectionId.outNodeId);
+		const auto& inputs = model.nodePortSchema(connectionId.inNodeId).inputs;
+		QStringView input;
+		if (connectionId.inPortIndex < static_cast<PortIndex>(inputs.size())) {
+			input = inputs[connectionId.inPortIndex].caption;
+		}
+		callback(Edge{connectionId, source.outputs.at(connectionId.outPortIndex), input});
+	}
+}
+
+void writeDot(BufferedWriter& out, const EntityGraphModel& model) {
+	out.write("digraph entities {\n\tnode [shape=box];\n");
+	model.forEachNode([&out](NodeId nodeId, const EntityGraphModel::NodeData& node) {
+		out.write('\t');
+		out.writeNumber(nodeId);
+		out.write(" [label=\"");
+		out.writeEscaped(node.caption, Escape::DOT);
+		out.write("\", classname=\"");
+		out.writeEscaped(node.type, Escape::DOT);
+		out.write("\"];\n");
+	});
+	forEachEdge(model, [&out](const Edge& edge) {
+		out.write('\t');
+		out.writeNumber(edge.id.outNodeId);
+		out.write(" -> ");
+		out.writeNumber(edge.id.inNodeId);
+		out.write(" [label=\"");
+		out.writeEscaped(edge.output.caption, Escape::DOT);
+		out.write(" > ");
+		out.writeEscaped(edge.input, Escape::DOT);
+		out.write("\", output=\"");
+		out.writeEscaped(edge.output.caption, Escape::DOT);
+		out.write("\", input=\"");
+		out.writeEscaped(edge.input, Escape::DOT);
+		out.write("\", parameter=\"");
+		out.writeEscaped(edge.output.parameter, Escape::DOT);
+		out.write("\", delay=");
+		out.writeNumber(edge.output.delay);
+		out.write("];\n");
+	});
+	out.write("}\n");
+}
+
+void writeGraphML(BufferedWriter& out, const EntityGraphModel& model) {
+	out.write(
+		"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+		"\t<key id=\"classname\" for=\"node\" attr.name=\"classname\" attr.type=\"string\"/>\n"
+		"\t<key id=\"caption\" for=\"node\" attr.name=\"caption\" attr.type=\"string\"/>\n"
+		"\t<key id=\"x\" for=\"node\" attr.name=\"x\" attr.type=\"double\"/>\n"
+		"\t<key id=\"y\" for=\"node\" attr.name=\"y\" attr.type=\"double\"/>\n"
+		"\t<key id=\"output\" for=\"edge\" attr.name=\"output\" attr.type=\"string\"/>\n"
+		"\t<key id=\"input\" for=\"edge\" attr.name=\"input\" attr.type=\"string\"/>\n"
+		"\t<key id=\"parameter\" for=\"edge\" attr.name=\"parameter\" attr.type=\"string\"/>\n"
+		"\t<key id=\"delay\" for=\"edge\" attr.name=\"delay\" attr.type=\"double\"/>\n"
+		"\t<graph id=\"entities\" edgedefault=\"directed\">\n");
+	model.forEachNode([&out](NodeId nodeId, const EntityGraphModel::NodeData& node) {
+		out.write("\t\t<node id=\"n");
+		out.writeNumber(nodeId);
+		out.write("\"><data key=\"classname\">");
+		out.writeEscaped(node.type, Escape::XML);
+		out.write("</data><data key=\"caption\">");
+		out.writeEscaped(node.caption, Escape::XML);
+		out.write("</data><data key=\"x\">");
+		out.writeNumber(node.position.x());
+		out.write("</data><data key=\"y\">");
+		out.writeNumber(node.position.y());
+		out.write("</data></node>\n");
+	});
+	forEachEdge(model, [&out](const Edge& edge) {
+		out.write("\t\t<edge source=\"n");
+		out.writeNumber(edge.id.outNodeId);
+		out.write("\" target=\"n");
+		out.writeNumber(edge.id.inNodeId);
+		out.write("\"><data key=\"output\">");
+		out.writeEscaped(edge.output.caption, Escape::XML);
+		out.write("</data><data key=\"input\">");
+		out.writeEscaped(edge.input, Escape::XML);
+		out.write("</data><data key=\"parameter\">");
+		out.writeEscaped(edge.output.parameter, Escape::XML);
+		out.write("</data><data key=\"delay\">");
+		out.writeNumber(edge.output.delay);
+		out.write("</data></edge>\n");
+	});
+	out.write("\t</graph>\n</graphml>\n");
+}
+
+void writeNDJSON(BufferedWriter& out, const EntityGraphModel& model) {
+	model.forEachNode([&out](NodeId nodeId, const EntityGraphModel::NodeData& node) {
+		out.write("{\"type\":\"node\",\"id\":");
+		out.writeNumber(nodeId);
+		out.write(",\"classname\":\"");
+		out.writeEscaped(node.type, Escape::JSON);
+		out.write("\",\"caption\":\"");
+		out.writeEscaped(node.caption, Escape::JSON);
+		out.write("\",\"x\":");
+		out.writeNumber(node.position.x());
+		out.write(",\"y\":");
+		out.writeNumber(node.position.y());
+		out.write("}\n");
+	});
+	forEachEdge(model, [&out](const Edge& edge) {
+		out.write("{\"type\":\"edge\",\"source\":");
+		out.writeNumber(edge.id.outNodeId);
+		out.write(",\"target\":");
+		out.writeNumber(edge.id.inNodeId);
+		out.write(",\"output\":\"");
+		out.writeEscaped(edge.output.caption, Escape::JSON);
+		out.write("\",\"input\":\"");
+		out.writeEscaped(edge.input, Escape::JSON);
+		out.write("\",\"parameter\":\"");
+		out.writeEscaped(edge.output.parameter, Escape::JSON);
+		out.write("\",\"delay\":");
+		out.writeNumber(edge.output.delay);
+		out.write("}\n");
+	});
+}
+
+} // namespace
+
+EntityGraphExporter::EntityGraphExporter(const EntityGraphModel& model_)
+		: model(model_) {}
+
+bool EntityGraphExporter::exportToFile(const QString& path, Format format) const {
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	if (!this->exportToDevice(file, format)) {
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
+
+bool EntityGraphExporter::exportToDevice(QIODevice& device, Format format) const {
+	ENTGRAPH_TRACE_SCOPE("EntityGraphExporter::exportToDevice", "io");
+
+	// Too big for the stack
+	auto out = std::make_unique<BufferedWriter>(device);
+	switch (format) {
+		case FORMAT_DOT:
+			writeDot(*out, this->model);
+			break;
+		case FORMAT_GRAPHML:
+			writeGraphML(*out, this->model);
+			break;
+		case FORMAT_NDJSON:
+			writeNDJSON(*out, this->model);
+			break;
+	}
+	return out->finish();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QString>
+
+class QIODevice;
+class EntityGraphModel;
+
+/// Writes the entity I/O graph out for other tools to read. Nodes and connections are streamed
+/// straight out of the model through a fixed-size buffer instead of being built into a document
+/// first, so exporting takes the same memory however large the graph is.
+class EntityGraphExporter {
+public:
+	enum Format {
+		/// Graphviz
+		FORMAT_DOT,
+		FORMAT_GRAPHML,
+		/// Newline-delimited JSON, one object per node or connection
+		FORMAT_NDJSON,
+	};
+
+	explicit EntityGraphExporter(const EntityGraphModel& model_);
+
+	/// The file is only replaced once everything was written successfully
+	bool exportToFile(const QString& path, Format format) const;
+
+	bool exportToDevice(QIODevice& device, Format format) const;
+
+private:
+	const EntityGraphModel& model;
+};
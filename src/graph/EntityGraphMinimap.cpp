@@ -0,0 +1,115 @@
+#include "EntityGraphMinimap.h"
+
+#include <algorithm>
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <QtNodes/GraphicsView>
+
+#include "EntityGraphModel.h"
+
+namespace {
+
+constexpr int MINIMAP_MARGIN = 6;
+
+/// Groups of nodes smaller than this many pixels are drawn as one rectangle
+constexpr qreal MIN_CLUSTER_PIXELS = 3.0;
+
+} // namespace
+
+EntityGraphMinimap::EntityGraphMinimap(const EntityGraphModel& model_, QtNodes::GraphicsView& view_, QWidget* parent)
+		: QWidget(parent)
+		, model(model_)
+		, view(view_) {
+	this->setFixedSize(220, 150);
+	this->setCursor(Qt::CrossCursor);
+
+	// Repaints are coalesced by Qt, so it's fine to ask for one on every change
+	const auto requestUpdate = [this] {
+		this->update();
+	};
+	QObject::connect(&this->model, &EntityGraphModel::nodeCreated, this, requestUpdate);
+	QObject::connect(&this->model, &EntityGraphModel::nodeDeleted, this, requestUpdate);
+	QObject::connect(&this->model, &EntityGraphModel::nodePositionUpdated, this, requestUpdate);
+	QObject::connect(this->view.horizontalScrollBar(), &QScrollBar::valueChanged, this, requestUpdate);
+	QObject::connect(this->view.verticalScrollBar(), &QScrollBar::valueChanged, this, requestUpdate);
+	QObject::connect(this->view.horizontalScrollBar(), &QScrollBar::rangeChanged, this, requestUpdate);
+	QObject::connect(this->view.verticalScrollBar(), &QScrollBar::rangeChanged, this, requestUpdate);
+}
+
+void EntityGraphMinimap::paintEvent(QPaintEvent* /*event*/) {
+	QPainter painter(this);
+	const auto palette = this->palette();
+
+	auto background = palette.color(QPalette::Window);
+	background.setAlpha(220);
+	painter.fillRect(this->rect(), background);
+	painter.setPen(palette.color(QPalette::Mid));
+	painter.drawRect(this->rect().adjusted(0, 0, -1, -1));
+
+	const auto& index = this->model.spatialIndex();
+	if (index.size() == 0) {
+		return;
+	}
+
+	const auto transform = this->sceneToWidget();
+	const auto minExtent = MIN_CLUSTER_PIXELS / std::max(transform.m11(), 1e-9);
+
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(palette.color(QPalette::Highlight));
+	index.visitClusters(minExtent, [&painter, &transform](const QRectF& bounds) {
+		// Keep nodes that haven't been laid out yet visible
+		auto mapped = transform.mapRect(bounds);
+		mapped.setWidth(std::max(mapped.width(), 1.0));
+		mapped.setHeight(std::max(mapped.height(), 1.0));
+		painter.drawRect(mapped);
+	});
+
+	painter.setBrush(Qt::NoBrush);
+	painter.setPen(QPen(palette.color(QPalette::WindowText), 1.0));
+	painter.drawRect(transform.mapRect(this->visibleSceneRect()));
+}
+
+void EntityGraphMinimap::mousePressEvent(QMouseEvent* event) {
+	if (event->button() == Qt::LeftButton) {
+		this->centerViewOn(event->position().toPoint());
+		event->accept();
+		return;
+	}
+	QWidget::mousePressEvent(event);
+}
+
+void EntityGraphMinimap::mouseMoveEvent(QMouseEvent* event) {
+	if (event->buttons() & Qt::LeftButton) {
+		this->centerViewOn(event->position().toPoint());
+		event->accept();
+		return;
+	}
+	QWidget::mouseMoveEvent(event);
+}
+
+QTransform EntityGraphMinimap::sceneToWidget() const {
+	const auto sceneRect = this->model.spatialIndex().bounds().united(this->visibleSceneRect());
+	const auto target = QRectF(this->rect()).adjusted(MINIMAP_MARGIN, MINIMAP_MARGIN, -MINIMAP_MARGIN, -MINIMAP_MARGIN);
+	if (sceneRect.width() <= 0 || sceneRect.height() <= 0) {
+		return {};
+	}
+
+	const auto scale = std::min(target.width() / sceneRect.width(), target.height() / sceneRect.height());
+	const auto offset = target.center() - sceneRect.center() * scale;
+	return {scale, 0, 0, scale, offset.x(), offset.y()};
+}
+
+QRectF EntityGraphMinimap::visibleSceneRect() const {
+	return this->view.mapToScene(this->view.viewport()->rect()).boundingRect();
+}
+
+void EntityGraphMinimap::centerViewOn(const QPoint& widgetPos) {
+	bool invertible = false;
+	const auto widgetToScene = this->sceneToWidget().inverted(&invertible);
+	if (invertible) {
+		this->view.centerOn(widgetToScene.map(QPointF(widgetPos)));
+	}
+}
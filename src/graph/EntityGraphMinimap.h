@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QTransform>
+#include <QWidget>
+
+class EntityGraphModel;
+
+namespace QtNodes {
+
+class GraphicsView;
+
+} // namespace QtNodes
+
+/// Overview of the whole graph, drawn straight from the model's spatial index rather than
+/// the scene, so it costs about the same with ten nodes or a hundred thousand.
+/// Click or drag to move the view.
+class EntityGraphMinimap : public QWidget {
+	Q_OBJECT;
+
+public:
+	EntityGraphMinimap(const EntityGraphModel& model_, QtNodes::GraphicsView& view_, QWidget* parent = nullptr);
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+
+	void mousePressEvent(QMouseEvent* event) override;
+
+	void mouseMoveEvent(QMouseEvent* event) override;
+
+private:
+	const EntityGraphModel& model;
+	QtNodes::GraphicsView& view;
+
+	/// Maps scene coordinates into the widget, fitting the graph and the visible area
+	[[nodiscard]] QTransform sceneToWidget() const;
+
+	[[nodiscard]] QRectF visibleSceneRect() const;
+
+	void centerViewOn(const QPoint& widgetPos);
+};
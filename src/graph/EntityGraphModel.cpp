@@ -1,9 +1,52 @@
 #include "EntityGraphModel.h"
 
+#include <cmath>
 #include <utility>
 
+#include <QSet>
+
+#include "../debug/MemoryReport.h"
+#include "../debug/Trace.h"
+#include "../fgd/FGDCache.h"
+#include "../wrapper/VMFWrapper.h"
+
+namespace {
+
+constexpr qreal NODE_SPACING_X = 400.0;
+constexpr qreal NODE_SPACING_Y = 300.0;
+
+const EntityGraphModel::NodePortSchemaPtr& emptyPortSchema() {
+	static const EntityGraphModel::NodePortSchemaPtr empty = std::make_shared<EntityGraphModel::NodePortSchema>();
+	return empty;
+}
+
+const EntityGraphModel::NodePortSchema& portSchemaOf(const EntityGraphModel::NodeData& node) {
+	return node.schema ? *node.schema : *emptyPortSchema();
+}
+
+} // namespace
+
+void EntityGraphModel::NodePortSchema::indexInputs() {
+	this->baseInputPorts.fill(QtNodes::InvalidPortIndex);
+	this->classInputPorts.clear();
+	for (PortIndex i = 0; i < static_cast<PortIndex>(this->inputs.size()); i++) {
+		if (const auto baseInput = BaseIO::findInput(QStringView{this->inputs[i].caption}); baseInput >= 0) {
+			this->baseInputPorts[baseInput] = i;
+		} else {
+			this->classInputPorts.insert(this->inputs[i].caption.toLower(), i);
+		}
+	}
+}
+
+PortIndex EntityGraphModel::NodePortSchema::inputPortIndex(QStringView name) const {
+	if (const auto baseInput = BaseIO::findInput(name); baseInput >= 0) {
+		return this->baseInputPorts[baseInput];
+	}
+	return this->classInputPorts.value(name.toString().toLower(), QtNodes::InvalidPortIndex);
+}
+
 std::unordered_set<NodeId> EntityGraphModel::allNodeIds() const {
-	return this->nodeIds;
+	return {this->nodeIds.begin(), this->nodeIds.end()};
 }
 
 std::unordered_set<ConnectionId> EntityGraphModel::allConnectionIds(NodeId nodeId) const {
@@ -22,6 +65,20 @@ std::unordered_set<ConnectionId> EntityGraphModel::connections(NodeId nodeId, Po
 	return result;
 }
 
+const EntityGraphModel::ConnectionIdSet& EntityGraphModel::allConnections() const {
+	return this->connectivity;
+}
+
+void EntityGraphModel::forEachNode(const std::function<void(NodeId nodeId, const NodeData& node)>& callback) const {
+	for (const auto& [nodeId, node] : this->nodes) {
+		callback(nodeId, node);
+	}
+}
+
+const EntityGraphModel::NodeData& EntityGraphModel::node(NodeId nodeId) const {
+	return this->nodes.at(nodeId);
+}
+
 bool EntityGraphModel::connectionExists(ConnectionId connectionId) const {
 	return this->connectivity.find(connectionId) != this->connectivity.end();
 }
@@ -31,14 +88,19 @@ NodeId EntityGraphModel::addNode(QString nodeType) {
 	this->nodeIds.insert(newId);
 	this->nodes[newId] = NodeData{};
 	this->nodes[newId].type = nodeType;
+	this->nodes[newId].schema = this->portSchema(nodeType);
+	this->updateNodeIndex(newId);
 	Q_EMIT this->nodeCreated(newId);
 	return newId;
 }
 
 NodeId EntityGraphModel::addNode(QString nodeType, NodeId nodeId) {
+	this->nextNodeId = std::max(this->nextNodeId, nodeId + 1);
 	this->nodeIds.insert(nodeId);
 	this->nodes[nodeId] = NodeData{};
+	this->nodes[nodeId].schema = this->portSchema(nodeType);
 	this->nodes[nodeId].type = std::move(nodeType);
+	this->updateNodeIndex(nodeId);
 	Q_EMIT this->nodeCreated(nodeId);
 	return nodeId;
 }
@@ -68,12 +130,21 @@ QVariant EntityGraphModel::nodeData(NodeId nodeId, NodeRole role) const {
 			return true;
 		case NodeRole::Caption:
 			return this->nodes[nodeId].caption;
-		case NodeRole::Style:
-			return StyleCollection::nodeStyle().toJson().toVariantMap();
+		case NodeRole::Style: {
+			auto style = StyleCollection::nodeStyle().toJson();
+			if (const auto& highlight = this->nodes[nodeId].highlight; highlight.isValid()) {
+				auto nodeStyle = style["NodeStyle"].toObject();
+				nodeStyle["NormalBoundaryColor"] = highlight.name();
+				nodeStyle["ShadowColor"] = highlight.name();
+				nodeStyle["PenWidth"] = 3.0;
+				style["NodeStyle"] = nodeStyle;
+			}
+			return style.toVariantMap();
+		}
 		case NodeRole::InternalData:
 			return {};
 		case NodeRole::InPortCount:
-			return static_cast<PortIndex>(this->nodes[nodeId].inputs.size());
+			return static_cast<PortIndex>(portSchemaOf(this->nodes[nodeId]).inputs.size());
 		case NodeRole::OutPortCount:
 			return static_cast<PortIndex>(this->nodes[nodeId].outputs.size());
 		case NodeRole::Widget:
@@ -91,11 +162,13 @@ bool EntityGraphModel::setNodeData(NodeId nodeId, NodeRole role, QVariant value)
 			break;
 		case NodeRole::Position:
 			this->nodes[nodeId].position = value.value<QPointF>();
+			this->updateNodeIndex(nodeId);
 			Q_EMIT this->nodePositionUpdated(nodeId);
 			result = true;
 			break;
 		case NodeRole::Size:
 			this->nodes[nodeId].size = value.value<QSize>();
+			this->updateNodeIndex(nodeId);
 			result = true;
 			break;
 		case NodeRole::CaptionVisible:
@@ -112,7 +185,11 @@ bool EntityGraphModel::setNodeData(NodeId nodeId, NodeRole role, QVariant value)
 			result = false;
 			break;
 		case NodeRole::InPortCount:
-			this->nodes[nodeId].inputs.resize(value.value<PortIndex>());
+			{
+				auto& schema = this->detachPortSchema(nodeId);
+				schema.inputs.resize(value.value<PortIndex>());
+				schema.indexInputs();
+			}
 			result = true;
 			break;
 		case NodeRole::OutPortCount:
@@ -135,14 +212,14 @@ QVariant EntityGraphModel::portData(NodeId nodeId, PortType portType, PortIndex
 			return {};
 		case PortRole::DataType:
 			if (portType == PortType::In) {
-				return this->nodes[nodeId].inputs.at(portIndex).type;
+				return portSchemaOf(this->nodes[nodeId]).inputs.at(portIndex).type;
 			} else if (portType == PortType::Out) {
 				return this->nodes[nodeId].outputs.at(portIndex).type;
 			}
 			return {};
 		case PortRole::ConnectionPolicyRole:
 			if (portType == PortType::In) {
-				return QVariant::fromValue(this->nodes[nodeId].inputs.at(portIndex).allowMultipleConnections ? ConnectionPolicy::Many : ConnectionPolicy::One);
+				return QVariant::fromValue(portSchemaOf(this->nodes[nodeId]).inputs.at(portIndex).allowMultipleConnections ? ConnectionPolicy::Many : ConnectionPolicy::One);
 			} else if (portType == PortType::Out) {
 				return QVariant::fromValue(this->nodes[nodeId].outputs.at(portIndex).allowMultipleConnections ? ConnectionPolicy::Many : ConnectionPolicy::One);
 			}
@@ -151,7 +228,7 @@ QVariant EntityGraphModel::portData(NodeId nodeId, PortType portType, PortIndex
 			return true;
 		case PortRole::Caption:
 			if (portType == PortType::In) {
-				return this->nodes[nodeId].inputs.at(portIndex).caption;
+				return portSchemaOf(this->nodes[nodeId]).inputs.at(portIndex).caption;
 			} else if (portType == PortType::Out) {
 				return this->nodes[nodeId].outputs.at(portIndex).caption;
 			}
@@ -168,7 +245,7 @@ bool EntityGraphModel::setPortData(NodeId nodeId, PortType portType, PortIndex p
 			break;
 		case PortRole::DataType:
 			if (portType == PortType::In) {
-				this->nodes[nodeId].inputs[portIndex].type = value.value<QString>();
+				this->detachPortSchema(nodeId).inputs[portIndex].type = value.value<QString>();
 				result = true;
 			} else if (portType == PortType::Out) {
 				this->nodes[nodeId].outputs[portIndex].type = value.value<QString>();
@@ -178,7 +255,7 @@ bool EntityGraphModel::setPortData(NodeId nodeId, PortType portType, PortIndex p
 		case PortRole::ConnectionPolicyRole: {
 			bool allowMultipleConnections = value.value<ConnectionPolicy>() == ConnectionPolicy::Many;
 			if (portType == PortType::In) {
-				this->nodes[nodeId].inputs[portIndex].allowMultipleConnections = allowMultipleConnections;
+				this->detachPortSchema(nodeId).inputs[portIndex].allowMultipleConnections = allowMultipleConnections;
 				result = true;
 			} else if (portType == PortType::Out) {
 				this->nodes[nodeId].outputs[portIndex].allowMultipleConnections = allowMultipleConnections;
@@ -191,7 +268,9 @@ bool EntityGraphModel::setPortData(NodeId nodeId, PortType portType, PortIndex p
 			break;
 		case PortRole::Caption:
 			if (portType == PortType::In) {
-				this->nodes[nodeId].inputs[portIndex].caption = value.value<QString>();
+				auto& schema = this->detachPortSchema(nodeId);
+				schema.inputs[portIndex].caption = value.value<QString>();
+				schema.indexInputs();
 				result = true;
 			} else if (portType == PortType::Out) {
 				this->nodes[nodeId].outputs[portIndex].caption = value.value<QString>();
@@ -210,6 +289,7 @@ bool EntityGraphModel::deleteConnection(ConnectionId connectionId) {
 	if (auto it = this->connectivity.find(connectionId); it != this->connectivity.end()) {
 		disconnected = true;
 		this->connectivity.erase(it);
+		this->connectionHighlights.erase(connectionId);
 	}
 	if (disconnected) {
 		Q_EMIT this->connectionDeleted(connectionId);
@@ -225,6 +305,7 @@ bool EntityGraphModel::deleteNode(NodeId nodeId) {
 	}
 	this->nodeIds.erase(nodeId);
 	this->nodes.erase(nodeId);
+	this->nodeIndex.remove(nodeId);
 	Q_EMIT this->nodeDeleted(nodeId);
 	return true;
 }
@@ -267,10 +348,177 @@ NodeId EntityGraphModel::newNodeId() {
 	NodeId id;
 	do {
 		id = this->nextNodeId++;
-	} while (!this->nodeIds.contains(id));
+	} while (this->nodeIds.contains(id));
 	return id;
 }
 
+EntityGraphModel::NodePortSchemaPtr EntityGraphModel::registerPortSchema(NodePortSchema schema) {
+	auto classname = schema.classname;
+	schema.indexInputs();
+	NodePortSchemaPtr ptr = std::make_shared<NodePortSchema>(std::move(schema));
+	this->schemas[classname] = ptr;
+	return ptr;
+}
+
+EntityGraphModel::NodePortSchemaPtr EntityGraphModel::portSchema(const QString& classname) const {
+	if (auto it = this->schemas.constFind(classname); it != this->schemas.constEnd()) {
+		return it.value();
+	}
+	return emptyPortSchema();
+}
+
+const EntityGraphModel::NodePortSchema& EntityGraphModel::nodePortSchema(NodeId nodeId) const {
+	return portSchemaOf(this->nodes.at(nodeId));
+}
+
+void EntityGraphModel::setNodePortSchema(NodeId nodeId, NodePortSchemaPtr schema) {
+	this->nodes[nodeId].schema = schema ? std::move(schema) : emptyPortSchema();
+	Q_EMIT this->nodeUpdated(nodeId);
+}
+
+void EntityGraphModel::setNodeHighlight(NodeId nodeId, const QColor& color) {
+	this->nodes[nodeId].highlight = color;
+	Q_EMIT this->nodeUpdated(nodeId);
+}
+
+void EntityGraphModel::setConnectionHighlight(ConnectionId connectionId, const QColor& color) {
+	if (color.isValid()) {
+		this->connectionHighlights[connectionId] = color;
+	} else if (!this->connectionHighlights.erase(connectionId)) {
+		return;
+	}
+	// Not nodeUpdated, which would have the scene recompute the node and every connection it has
+	Q_EMIT this->connectionHighlightUpdated(connectionId);
+}
+
+QColor EntityGraphModel::connectionHighlight(ConnectionId connectionId) const {
+	if (const auto it = this->connectionHighlights.find(connectionId); it != this->connectionHighlights.end()) {
+		return it->second;
+	}
+	return {};
+}
+
+bool EntityGraphModel::hasConnectionHighlights() const {
+	return !this->connectionHighlights.empty();
+}
+
+const SpatialIndex& EntityGraphModel::spatialIndex() const {
+	return this->nodeIndex;
+}
+
+QList<NodeId> EntityGraphModel::nodesInRect(const QRectF& rect) const {
+	return this->nodeIndex.query(rect);
+}
+
+void EntityGraphModel::updateNodeIndex(NodeId nodeId) {
+	const auto& node = this->nodes[nodeId];
+	this->nodeIndex.insert(nodeId, {node.position, node.size.isValid() ? QSizeF(node.size) : QSizeF()});
+}
+
+EntityGraphModel::NodePortSchema& EntityGraphModel::detachPortSchema(NodeId nodeId) {
+	auto& node = this->nodes[nodeId];
+	if (node.schema && node.schema.use_count() == 1) {
+		// Nobody else holds this schema, and it was created mutable below, so it's safe to edit in place
+		return const_cast<NodePortSchema&>(*node.schema);
+	}
+	auto copy = std::make_shared<NodePortSchema>(portSchemaOf(node));
+	node.schema = copy;
+	return *copy;
+}
+
+void EntityGraphModel::loadEntities(const QList<EntityKV>& entities, const FGDCache* fgd) {
+	ENTGRAPH_TRACE_SCOPE("EntityGraphModel::loadEntities", "model");
+
+	// One schema per entity class, shared by every entity of that class.
+	// Every class gets the base inputs, and the FGD only adds the inputs specific to the class
+	QHash<QString, QHash<QString, QString>> classOutputTypes;
+	{
+		ENTGRAPH_TRACE_SCOPE("EntityGraphModel::loadEntities schemas", "model");
+		QSet<QString> seenClasses;
+		for (const auto& entity : entities) {
+			if (seenClasses.contains(entity.classname)) {
+				continue;
+			}
+			seenClasses.insert(entity.classname);
+
+			// Every entity has the base inputs whether its FGD lists them or not, so they always come first
+			NodePortSchema schema{.classname = entity.classname};
+			schema.inputs.reserve(BaseIO::INPUTS.size());
+			for (const auto input : BaseIO::INPUTS) {
+				schema.inputs.push_back({.type = QString(), .caption = QString::fromLatin1(input), .allowMultipleConnections = true});
+			}
+			if (const auto entityClass = fgd ? fgd->findClass(entity.classname) : std::nullopt) {
+				for (qsizetype i = 0; i < entityClass->inputCount(); i++) {
+					const auto input = entityClass->input(i);
+					if (const auto baseInput = BaseIO::findInput(input.name); baseInput >= 0) {
+						schema.inputs[baseInput].type = input.type.toString();
+						continue;
+					}
+					schema.inputs.push_back({.type = input.type.toString(), .caption = input.name.toString(), .allowMultipleConnections = true});
+				}
+
+				auto& outputTypes = classOutputTypes[entity.classname];
+				for (qsizetype i = 0; i < entityClass->outputCount(); i++) {
+					const auto output = entityClass->output(i);
+					if (BaseIO::findOutput(output.name) < 0) {
+						outputTypes.insert(output.name.toString().toLower(), output.type.toString());
+					}
+				}
+			}
+			this->registerPortSchema(std::move(schema));
+		}
+	}
+
+	// Targetnames aren't unique, and are case-insensitive
+	QHash<QString, QList<NodeId>> namedEntityIds;
+	{
+		// Includes QtNodes building the scene items, which happens as each node is created
+		ENTGRAPH_TRACE_SCOPE("EntityGraphModel::loadEntities nodes", "model");
+		const auto columns = std::max<qsizetype>(1, static_cast<qsizetype>(std::ceil(std::sqrt(static_cast<double>(entities.size())))));
+		for (qsizetype i = 0; i < entities.size(); i++) {
+			const auto& entity = entities[i];
+			const NodeId id = this->addNode(entity.classname, entity.id);
+			if (!entity.targetname.isEmpty()) {
+				namedEntityIds[entity.targetname.toLower()].push_back(id);
+			}
+			this->setNodeData(id, NodeRole::Caption, entity.targetname.isEmpty() ? entity.classname : entity.targetname + " (" + entity.classname + ")");
+			this->setNodeData(id, NodeRole::Position, QPointF(static_cast<qreal>(i % columns) * NODE_SPACING_X, static_cast<qreal>(i / columns) * NODE_SPACING_Y));
+		}
+	}
+
+	{
+		ENTGRAPH_TRACE_SCOPE("EntityGraphModel::loadEntities connections", "model");
+		for (const auto& entity : entities) {
+			const NodeId id = entity.id;
+			auto& outputs = this->nodes[id].outputs;
+			outputs.reserve(entity.connections.size());
+			const auto outputTypes = classOutputTypes.constFind(entity.classname);
+			for (const auto& connection : entity.connections) {
+				// Base outputs have no type to look up, like base inputs
+				QString type;
+				if (BaseIO::findOutput(QStringView{connection.output}) < 0 && outputTypes != classOutputTypes.constEnd()) {
+					type = outputTypes->value(connection.output.toLower());
+				}
+				outputs.push_back({{.type = type, .caption = connection.output, .allowMultipleConnections = true}, connection.parameter, connection.delay.toFloat()});
+			}
+			Q_EMIT this->nodeUpdated(id);
+
+			for (PortIndex i = 0; i < static_cast<PortIndex>(entity.connections.size()); i++) {
+				const auto& connection = entity.connections[i];
+				const auto targets = namedEntityIds.constFind(connection.targetname.toLower());
+				if (targets == namedEntityIds.constEnd()) {
+					continue;
+				}
+				for (const NodeId targetId : *targets) {
+					if (const auto targetPort = portSchemaOf(this->nodes[targetId]).inputPortIndex(connection.input); targetPort != QtNodes::InvalidPortIndex) {
+						this->addConnection({id, i, targetId, targetPort});
+					}
+				}
+			}
+		}
+	}
+}
+
 void EntityGraphModel::clear() {
 	// Delete connections
 	std::vector<ConnectionId> connectionsToDelete;
@@ -292,4 +540,50 @@ void EntityGraphModel::clear() {
 
 	// Reset id tracker
 	this->nextNodeId = 0;
+
+	this->nodeIndex.clear();
+	// The next map registers the classes it uses, so don't let every class ever loaded pile up
+	this->schemas.clear();
+}
+
+void EntityGraphModel::reportMemory(MemoryReport& report) const {
+	// Shared schemas are counted once, including copies nodes detached for themselves
+	QSet<const NodePortSchema*> uniqueSchemas;
+	for (const auto& schema : this->schemas) {
+		uniqueSchemas.insert(schema.get());
+	}
+
+	qint64 nodeStringBytes = 0;
+	qint64 outputBytes = 0;
+	qint64 outputCount = 0;
+	for (const auto& [nodeId, node] : this->nodes) {
+		nodeStringBytes += MemoryUsage::heap(node.type) + MemoryUsage::heap(node.caption);
+		outputBytes += MemoryUsage::heap(node.outputs);
+		for (const auto& output : node.outputs) {
+			outputBytes += MemoryUsage::heap(output.type) + MemoryUsage::heap(output.caption) + MemoryUsage::heap(output.parameter);
+		}
+		outputCount += node.outputs.size();
+		if (node.schema) {
+			uniqueSchemas.insert(node.schema.get());
+		}
+	}
+
+	qint64 schemaBytes = MemoryUsage::heap(this->schemas);
+	for (const auto* schema : uniqueSchemas) {
+		schemaBytes += static_cast<qint64>(sizeof(NodePortSchema)) + MemoryUsage::heap(schema->classname) + MemoryUsage::heap(schema->inputs) + MemoryUsage::heap(schema->classInputPorts);
+		for (const auto& input : schema->inputs) {
+			schemaBytes += MemoryUsage::heap(input.type) + MemoryUsage::heap(input.caption);
+		}
+		for (const auto& key : schema->classInputPorts.keys()) {
+			schemaBytes += MemoryUsage::heap(key);
+		}
+	}
+
+	report.add("Graph model", "Nodes", NodeMemoryTag::bytes.load(std::memory_order_relaxed), static_cast<qint64>(this->nodes.size()), MemoryReport::KIND_EXACT);
+	report.add("Graph model", "Node names", nodeStringBytes, static_cast<qint64>(this->nodes.size()));
+	report.add("Graph model", "Output ports", outputBytes, outputCount);
+	report.add("Graph model", "Input port schemas", schemaBytes, uniqueSchemas.size());
+	report.add("Graph model", "Connections", ConnectionMemoryTag::bytes.load(std::memory_order_relaxed), static_cast<qint64>(this->connectivity.size()), MemoryReport::KIND_EXACT);
+	report.add("Graph model", "Connection highlights", MemoryUsage::heapOfNodes(this->connectionHighlights), static_cast<qint64>(this->connectionHighlights.size()));
+	report.add("Graph model", "Spatial index", this->nodeIndex.memoryUsage(), this->nodeIndex.size());
 }
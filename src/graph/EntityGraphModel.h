@@ -1,5 +1,12 @@
 #pragma once
 
+#include <array>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include <QColor>
+#include <QHash>
 #include <QJsonObject>
 #include <QPointF>
 #include <QSize>
@@ -8,6 +15,10 @@
 #include <QtNodes/ConnectionIdUtils>
 #include <QtNodes/StyleCollection>
 
+#include "../debug/CountingAllocator.h"
+#include "../fgd/BaseIO.h"
+#include "SpatialIndex.h"
+
 using ConnectionId = QtNodes::ConnectionId;
 using ConnectionPolicy = QtNodes::ConnectionPolicy;
 using NodeFlag = QtNodes::NodeFlag;
@@ -18,6 +29,10 @@ using PortRole = QtNodes::PortRole;
 using PortType = QtNodes::PortType;
 using StyleCollection = QtNodes::StyleCollection;
 
+class FGDCache;
+class MemoryReport;
+struct EntityKV;
+
 class EntityGraphModel : public QtNodes::AbstractGraphModel {
 	Q_OBJECT;
 
@@ -30,9 +45,33 @@ public:
 
 	struct NodePortOutput : public NodePortInput {
 		QString parameter;
-		int delay;
+		float delay;
+	};
+
+	/// The input ports of an entity class. Immutable once registered, and shared between every node of that class
+	struct NodePortSchema {
+		QString classname;
+		QList<NodePortInput> inputs;
+
+		/// Port of each BaseIO input on this class, or QtNodes::InvalidPortIndex if the class doesn't have it
+		std::array<PortIndex, BaseIO::INPUTS.size()> baseInputPorts = [] {
+			std::array<PortIndex, BaseIO::INPUTS.size()> ports;
+			ports.fill(QtNodes::InvalidPortIndex);
+			return ports;
+		}();
+
+		/// Ports of the remaining class-specific inputs, keyed by lowercase name
+		QHash<QString, PortIndex> classInputPorts;
+
+		/// Rebuilds the name lookups after the inputs change
+		void indexInputs();
+
+		/// Case-insensitive. Returns QtNodes::InvalidPortIndex if the class doesn't have this input
+		[[nodiscard]] PortIndex inputPortIndex(QStringView name) const;
 	};
 
+	using NodePortSchemaPtr = std::shared_ptr<const NodePortSchema>;
+
 	struct NodeData {
 		QSize size;
 		QPointF position;
@@ -40,10 +79,23 @@ public:
 		QString type;
 		QString caption;
 
-		QList<NodePortInput> inputs;
+		NodePortSchemaPtr schema;
 		QList<NodePortOutput> outputs;
+
+		/// Drawn over the node's border when valid
+		QColor highlight;
 	};
 
+	/// Allocation counters for the containers below, read by reportMemory
+	struct NodeMemoryTag {
+		static inline std::atomic_int64_t bytes = 0;
+	};
+	struct ConnectionMemoryTag {
+		static inline std::atomic_int64_t bytes = 0;
+	};
+
+	using ConnectionIdSet = std::unordered_set<ConnectionId, std::hash<ConnectionId>, std::equal_to<ConnectionId>, CountingAllocator<ConnectionId, ConnectionMemoryTag>>;
+
 public:
 	EntityGraphModel() = default;
 
@@ -53,6 +105,15 @@ public:
 
 	std::unordered_set<ConnectionId> connections(NodeId nodeId, PortType portType, PortIndex portIndex) const override;
 
+	/// Every connection in the graph
+	[[nodiscard]] const ConnectionIdSet& allConnections() const;
+
+	/// Calls back with every node, without copying the ids like allNodeIds() does
+	void forEachNode(const std::function<void(NodeId nodeId, const NodeData& node)>& callback) const;
+
+	/// The node must exist
+	[[nodiscard]] const NodeData& node(NodeId nodeId) const;
+
 	bool connectionExists(ConnectionId connectionId) const override;
 
 	NodeId addNode(QString nodeType) override;
@@ -90,16 +151,66 @@ public:
 
 	NodeId newNodeId() override;
 
+	/// Registers the input ports for an entity class, replacing any schema already registered for it
+	NodePortSchemaPtr registerPortSchema(NodePortSchema schema);
+
+	/// Returns the schema registered for the given entity class, or an empty schema if there isn't one
+	[[nodiscard]] NodePortSchemaPtr portSchema(const QString& classname) const;
+
+	/// The node's own schema if it was edited, otherwise its class's, or an empty schema. The node must exist
+	[[nodiscard]] const NodePortSchema& nodePortSchema(NodeId nodeId) const;
+
+	void setNodePortSchema(NodeId nodeId, NodePortSchemaPtr schema);
+
+	/// Pass an invalid color to remove the highlight
+	void setNodeHighlight(NodeId nodeId, const QColor& color);
+
+	/// Pass an invalid color to remove the highlight. Highlights go away with their connection
+	void setConnectionHighlight(ConnectionId connectionId, const QColor& color);
+
+	/// An invalid color if the connection isn't highlighted
+	[[nodiscard]] QColor connectionHighlight(ConnectionId connectionId) const;
+
+	[[nodiscard]] bool hasConnectionHighlights() const;
+
+	/// Scene bounds of every node, kept up to date as nodes are added, moved, and resized
+	[[nodiscard]] const SpatialIndex& spatialIndex() const;
+
+	/// Every node whose bounds intersect the given scene rect
+	[[nodiscard]] QList<NodeId> nodesInRect(const QRectF& rect) const;
+
+	/// Adds a node for every entity and connects their outputs to the inputs of their targets.
+	/// If an FGD is given, it provides the input ports for each entity class
+	void loadEntities(const QList<EntityKV>& entities, const FGDCache* fgd = nullptr);
+
 	void clear();
 
+	void reportMemory(MemoryReport& report) const;
+
+Q_SIGNALS:
+	void connectionHighlightUpdated(ConnectionId connectionId);
+
 private:
-	std::unordered_set<NodeId> nodeIds;
+	std::unordered_set<NodeId, std::hash<NodeId>, std::equal_to<NodeId>, CountingAllocator<NodeId, NodeMemoryTag>> nodeIds;
 	NodeId nextNodeId = 0;
 
 	/// Contains the graph connectivity information in both directions, i.e. from Node1 to Node2 and from Node2 to Node1
 	/// This one is user-defined and can be changed
-	std::unordered_set<ConnectionId> connectivity;
+	ConnectionIdSet connectivity;
 
 	/// Node data
-	mutable std::unordered_map<NodeId, NodeData> nodes;
+	mutable std::unordered_map<NodeId, NodeData, std::hash<NodeId>, std::equal_to<NodeId>, CountingAllocator<std::pair<const NodeId, NodeData>, NodeMemoryTag>> nodes;
+
+	/// Port schemas, keyed by entity class
+	QHash<QString, NodePortSchemaPtr> schemas;
+
+	/// Only the few connections that were given a highlight
+	std::unordered_map<ConnectionId, QColor> connectionHighlights;
+
+	SpatialIndex nodeIndex;
+
+	void updateNodeIndex(NodeId nodeId);
+
+	/// Gives a node its own copy of its schema so it can be edited without touching other nodes of the same class
+	NodePortSchema& detachPortSchema(NodeId nodeId);
 };
@@ -0,0 +1,61 @@
+#include "EntityGraphView.h"
+
+#if ENTGRAPH_ENABLE_TRACING
+
+#include <algorithm>
+#include <numeric>
+
+#include <QElapsedTimer>
+#include <QPainter>
+
+#include "../debug/Trace.h"
+
+void EntityGraphView::setFrameStatsVisible(bool visible) {
+	this->frameStatsVisible = visible;
+	this->viewport()->update();
+}
+
+void EntityGraphView::paintEvent(QPaintEvent* event) {
+	ENTGRAPH_TRACE_SCOPE("EntityGraphView::paintEvent", "paint");
+
+	QElapsedTimer timer;
+	timer.start();
+	QtNodes::GraphicsView::paintEvent(event);
+
+	this->frameTimesNs[this->nextFrame] = timer.nsecsElapsed();
+	this->nextFrame = (this->nextFrame + 1) % FRAME_HISTORY;
+	this->frameCount = std::min(this->frameCount + 1, FRAME_HISTORY);
+}
+
+void EntityGraphView::drawForeground(QPainter* painter, const QRectF& rect) {
+	QtNodes::GraphicsView::drawForeground(painter, rect);
+	if (!this->frameStatsVisible || this->frameCount == 0) {
+		return;
+	}
+
+	// The frame being painted isn't finished yet, so these are the stats of the ones before it
+	const auto last = this->frameTimesNs[(this->nextFrame + FRAME_HISTORY - 1) % FRAME_HISTORY];
+	const auto first = this->frameTimesNs.begin();
+	const auto end = first + this->frameCount;
+	const auto average = std::accumulate(first, end, qint64{0}) / this->frameCount;
+	const auto worst = *std::max_element(first, end);
+	const auto onScreen = this->items(this->viewport()->rect()).size();
+
+	const auto text = tr("Frame: %1 ms\nAverage: %2 ms\nWorst: %3 ms\nItems on screen: %4")
+		.arg(static_cast<double>(last) / 1e6, 0, 'f', 2)
+		.arg(static_cast<double>(average) / 1e6, 0, 'f', 2)
+		.arg(static_cast<double>(worst) / 1e6, 0, 'f', 2)
+		.arg(onScreen);
+
+	painter->save();
+	painter->resetTransform();
+	const auto textRect = painter->fontMetrics().boundingRect(QRect(0, 0, 1000, 1000), Qt::AlignLeft | Qt::AlignTop, text).adjusted(-6, -4, 6, 4).translated(12, 12);
+	painter->setPen(Qt::NoPen);
+	painter->setBrush(QColor(0, 0, 0, 160));
+	painter->drawRect(textRect);
+	painter->setPen(Qt::white);
+	painter->drawText(textRect, Qt::AlignCenter, text);
+	painter->restore();
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QtNodes/GraphicsView>
+
+#include "../config/Config.h"
+
+#if ENTGRAPH_ENABLE_TRACING
+#include <array>
+#endif
+
+/// The graph's view. With tracing compiled in, it times every frame it paints and can draw
+/// the frame times and how many items are on screen over the top of the graph.
+class EntityGraphView : public QtNodes::GraphicsView {
+	Q_OBJECT;
+
+public:
+	using QtNodes::GraphicsView::GraphicsView;
+
+#if ENTGRAPH_ENABLE_TRACING
+	void setFrameStatsVisible(bool visible);
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+
+	void drawForeground(QPainter* painter, const QRectF& rect) override;
+
+private:
+	static constexpr int FRAME_HISTORY = 120;
+
+	bool frameStatsVisible = false;
+	std::array<qint64, FRAME_HISTORY> frameTimesNs{};
+	int nextFrame = 0;
+	int frameCount = 0;
+#endif
+};
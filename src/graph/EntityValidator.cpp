@@ -0,0 +1,193 @@
+#include "EntityValidator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+
+#include "../debug/Trace.h"
+#include "../fgd/BaseIO.h"
+#include "../fgd/FGDCache.h"
+#include "../wrapper/VMFWrapper.h"
+
+namespace {
+
+/// Lowercased names of what a class has according to the FGD, if the FGD knows it
+struct ClassIO {
+	bool known = false;
+	QSet<QString> inputs;
+	QSet<QString> outputs;
+};
+
+/// Everything the checks look up, built once up front and only read by the threads after that
+struct Lookups {
+	/// Lowercase targetname -> lowercase classnames of the entities with that name
+	QHash<QString, QStringList> classesByName;
+	/// Lowercase targetnames, sorted so wildcards can find the names they match with a binary search
+	QStringList sortedNames;
+	/// Lowercase classname -> what it has
+	QHash<QString, ClassIO> classes;
+};
+
+Lookups buildLookups(const QList<EntityKV>& entities, const FGDCache* fgd) {
+	Lookups lookups;
+	for (const auto& entity : entities) {
+		const auto classname = entity.classname.toLower();
+		if (!lookups.classes.contains(classname)) {
+			ClassIO io;
+			if (const auto entityClass = fgd ? fgd->findClass(classname) : std::nullopt) {
+				io.known = true;
+				for (qsizetype i = 0; i < entityClass->inputCount(); i++) {
+					io.inputs.insert(entityClass->input(i).name.toString().toLower());
+				}
+				for (qsizetype i = 0; i < entityClass->outputCount(); i++) {
+					io.outputs.insert(entityClass->output(i).name.toString().toLower());
+				}
+			}
+			lookups.classes.insert(classname, std::move(io));
+		}
+		if (!entity.targetname.isEmpty()) {
+			auto& classes = lookups.classesByName[entity.targetname.toLower()];
+			if (!classes.contains(classname)) {
+				classes.push_back(classname);
+			}
+		}
+	}
+	lookups.sortedNames = lookups.classesByName.keys();
+	std::sort(lookups.sortedNames.begin(), lookups.sortedNames.end());
+	return lookups;
+}
+
+/// Lowercase classes of whatever the target resolves to, which is empty if nothing matches.
+/// Returns std::nullopt if the target can't be known until the map is running, like !activator
+std::optional<QStringList> resolveTargetClasses(const Lookups& lookups, const QString& sourceClass, const QString& target) {
+	if (target.startsWith('!')) {
+		if (target.compare("!self", Qt::CaseInsensitive) == 0) {
+			return QStringList{sourceClass};
+		}
+		return std::nullopt;
+	}
+
+	const auto name = target.toLower();
+	if (name.endsWith('*')) {
+		const auto prefix = QStringView{name}.chopped(1);
+		QStringList classes;
+		for (auto it = std::lower_bound(lookups.sortedNames.cbegin(), lookups.sortedNames.cend(), prefix); it != lookups.sortedNames.cend() && it->startsWith(prefix); ++it) {
+			for (const auto& classname : *lookups.classesByName.constFind(*it)) {
+				if (!classes.contains(classname)) {
+					classes.push_back(classname);
+				}
+			}
+		}
+		return classes;
+	}
+
+	if (const auto it = lookups.classesByName.constFind(name); it != lookups.classesByName.constEnd()) {
+		return *it;
+	}
+	// The engine falls back to classnames when no entity has the name
+	if (lookups.classes.contains(name)) {
+		return QStringList{name};
+	}
+	return QStringList{};
+}
+
+void checkConnection(const Lookups& lookups, const EntityKV& entity, const QString& sourceClass, qsizetype index, QList<EntityValidator::Diagnostic>& out) {
+	const auto& connection = entity.connections[index];
+	const auto report = [&](EntityValidator::Severity severity, QString message) {
+		out.push_back({severity, entity.id, index, std::move(message)});
+	};
+
+	if (BaseIO::findOutput(QStringView{connection.output}) < 0) {
+		if (const auto io = lookups.classes.constFind(sourceClass); io != lookups.classes.constEnd() && io->known && !io->outputs.contains(connection.output.toLower())) {
+			report(EntityValidator::SEVERITY_WARNING, EntityValidator::tr("\"%1\" isn't an output of %2").arg(connection.output, entity.classname));
+		}
+	}
+
+	if (connection.targetname.isEmpty()) {
+		report(EntityValidator::SEVERITY_ERROR, EntityValidator::tr("%1 has no target").arg(connection.output));
+	} else if (const auto targetClasses = resolveTargetClasses(lookups, sourceClass, connection.targetname)) {
+		if (targetClasses->isEmpty()) {
+			// Could still be spawned later by a template or a maker, so this one only warns
+			report(EntityValidator::SEVERITY_WARNING, EntityValidator::tr("Target \"%1\" doesn't match any entity").arg(connection.targetname));
+		} else if (BaseIO::findInput(QStringView{connection.input}) < 0) {
+			const auto input = connection.input.toLower();
+			QStringList missingFrom;
+			for (const auto& classname : *targetClasses) {
+				if (const auto io = lookups.classes.constFind(classname); io != lookups.classes.constEnd() && io->known && !io->inputs.contains(input)) {
+					missingFrom.push_back(classname);
+				}
+			}
+			if (!missingFrom.isEmpty()) {
+				report(EntityValidator::SEVERITY_ERROR, EntityValidator::tr("\"%1\" isn't an input of %2 (target \"%3\")").arg(connection.input, missingFrom.join(", "), connection.targetname));
+			}
+		}
+	}
+
+	bool delayValid = false;
+	const auto delay = connection.delay.toFloat(&delayValid);
+	if (!delayValid || !std::isfinite(delay)) {
+		report(EntityValidator::SEVERITY_ERROR, EntityValidator::tr("Delay \"%1\" isn't a number").arg(connection.delay));
+	} else if (delay < 0) {
+		report(EntityValidator::SEVERITY_ERROR, EntityValidator::tr("Delay %1 is negative").arg(connection.delay));
+	}
+
+	// Only -1 is meant to fire forever, but the engine counts down and stops at exactly zero, so these never stop either
+	if (connection.fireAmount == 0 || connection.fireAmount < -1) {
+		report(EntityValidator::SEVERITY_WARNING, EntityValidator::tr("A fire count of %1 never runs out, use -1 to mean every time").arg(connection.fireAmount));
+	}
+}
+
+} // namespace
+
+EntityValidator::EntityValidator(const FGDCache* fgd_)
+		: fgd(fgd_) {}
+
+QList<EntityValidator::Diagnostic> EntityValidator::validate(const QList<EntityKV>& entities) const {
+	ENTGRAPH_TRACE_SCOPE("EntityValidator::validate", "validate");
+	const auto lookups = buildLookups(entities, this->fgd);
+
+	// A few ranges per thread, so one range full of heavily connected entities doesn't hold up the rest
+	const auto taskSize = std::max(MIN_ENTITIES_PER_TASK, entities.size() / (QThread::idealThreadCount() * 4) + 1);
+	const auto taskCount = (entities.size() + taskSize - 1) / taskSize;
+	std::vector<QList<Diagnostic>> results(taskCount);
+
+	const auto checkRange = [&](qsizetype task) {
+		ENTGRAPH_TRACE_SCOPE("EntityValidator::validate task", "validate");
+		const auto end = std::min(entities.size(), (task + 1) * taskSize);
+		for (auto i = task * taskSize; i < end; i++) {
+			const auto& entity = entities[i];
+			if (entity.connections.isEmpty()) {
+				continue;
+			}
+			const auto sourceClass = entity.classname.toLower();
+			for (qsizetype j = 0; j < entity.connections.size(); j++) {
+				checkConnection(lookups, entity, sourceClass, j, results[task]);
+			}
+		}
+	};
+	if (taskCount > 1) {
+		QThreadPool pool;
+		for (qsizetype task = 1; task < taskCount; task++) {
+			pool.start([&checkRange, task] {
+				checkRange(task);
+			});
+		}
+		// This thread would only be waiting otherwise
+		checkRange(0);
+		pool.waitForDone();
+	} else if (taskCount == 1) {
+		checkRange(0);
+	}
+
+	QList<Diagnostic> diagnostics;
+	for (auto& result : results) {
+		diagnostics.append(std::move(result));
+	}
+	return diagnostics;
+}
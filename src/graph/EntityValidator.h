@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QCoreApplication>
+#include <QList>
+#include <QString>
+
+struct EntityKV;
+class FGDCache;
+
+/// Checks every connection in a map for problems the engine would only show at runtime, if at all:
+/// targets that don't exist, inputs and outputs the classes involved don't have, and bad delays
+/// or fire counts. Entities are split into ranges that are checked in parallel.
+class EntityValidator {
+	Q_DECLARE_TR_FUNCTIONS(EntityValidator);
+
+public:
+	enum Severity {
+		SEVERITY_ERROR,
+		SEVERITY_WARNING,
+	};
+
+	struct Diagnostic {
+		Severity severity;
+		int entityId;
+		/// Index into the entity's connections
+		qsizetype connection;
+		QString message;
+	};
+
+	/// Fewest entities worth handing to another thread
+	static constexpr qsizetype MIN_ENTITIES_PER_TASK = 512;
+
+	/// Without an FGD, only inputs and outputs every entity has are known, so names can't be checked
+	explicit EntityValidator(const FGDCache* fgd_ = nullptr);
+
+	/// Sorted by entity, in the order the entities were given
+	[[nodiscard]] QList<Diagnostic> validate(const QList<EntityKV>& entities) const;
+
+private:
+	const FGDCache* fgd;
+};
@@ -0,0 +1,199 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+#include "../debug/MemoryReport.h"
+#include "../debug/Trace.h"
+
+namespace {
+
+/// Below this many pending nodes, checking them one by one is cheaper than repacking
+constexpr qsizetype MIN_PENDING_BEFORE_PACK = 64;
+
+// QRectF ignores rectangles with no area when uniting and intersecting, but a node that hasn't
+// been laid out yet still has a position worth indexing
+
+QRectF unite(const QRectF& lhs, const QRectF& rhs) {
+	const auto left = std::min(lhs.left(), rhs.left());
+	const auto top = std::min(lhs.top(), rhs.top());
+	return {left, top, std::max(lhs.right(), rhs.right()) - left, std::max(lhs.bottom(), rhs.bottom()) - top};
+}
+
+bool overlaps(const QRectF& lhs, const QRectF& rhs) {
+	return lhs.left() <= rhs.right() && rhs.left() <= lhs.right() && lhs.top() <= rhs.bottom() && rhs.top() <= lhs.bottom();
+}
+
+/// Sorts items into vertical slices by x, then each slice by y, so every run of
+/// MAX_CHILDREN items is a compact tile that can become one tree node
+template<typename T>
+void sortTileRecursive(std::vector<T>& items) {
+	const auto count = items.size();
+	const auto pageCount = (count + SpatialIndex::MAX_CHILDREN - 1) / SpatialIndex::MAX_CHILDREN;
+	const auto sliceSize = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(pageCount)))) * SpatialIndex::MAX_CHILDREN;
+
+	std::sort(items.begin(), items.end(), [](const T& lhs, const T& rhs) {
+		return lhs.bounds.center().x() < rhs.bounds.center().x();
+	});
+	for (std::size_t start = 0; start < count; start += sliceSize) {
+		std::sort(items.begin() + static_cast<std::ptrdiff_t>(start), items.begin() + static_cast<std::ptrdiff_t>(std::min(start + sliceSize, count)), [](const T& lhs, const T& rhs) {
+			return lhs.bounds.center().y() < rhs.bounds.center().y();
+		});
+	}
+}
+
+/// One parent for every run of MAX_CHILDREN children
+template<typename T, typename TreeNode>
+std::vector<TreeNode> packLevel(const std::vector<T>& children) {
+	std::vector<TreeNode> parents;
+	parents.reserve((children.size() + SpatialIndex::MAX_CHILDREN - 1) / SpatialIndex::MAX_CHILDREN);
+	for (std::size_t first = 0; first < children.size(); first += SpatialIndex::MAX_CHILDREN) {
+		const auto last = std::min(first + SpatialIndex::MAX_CHILDREN, children.size());
+		auto bounds = children[first].bounds;
+		for (auto i = first + 1; i < last; i++) {
+			bounds = unite(bounds, children[i].bounds);
+		}
+		parents.push_back({bounds, static_cast<int>(first), static_cast<int>(last - first)});
+	}
+	return parents;
+}
+
+} // namespace
+
+void SpatialIndex::insert(NodeId nodeId, const QRectF& bounds) {
+	this->nodeBounds.insert(nodeId, bounds);
+	this->pending.insert(nodeId);
+}
+
+void SpatialIndex::remove(NodeId nodeId) {
+	if (this->nodeBounds.remove(nodeId)) {
+		this->pending.insert(nodeId);
+	}
+}
+
+void SpatialIndex::clear() {
+	this->nodeBounds.clear();
+	this->pending.clear();
+	this->entries.clear();
+	this->levels.clear();
+}
+
+qsizetype SpatialIndex::size() const {
+	return this->nodeBounds.size();
+}
+
+QRectF SpatialIndex::bounds() const {
+	this->flush();
+
+	// Nodes removed since the last pack can leave this a little larger than it should be
+	std::optional<QRectF> out;
+	if (!this->levels.empty() && !this->levels.back().empty()) {
+		out = this->levels.back().front().bounds;
+	}
+	for (const auto nodeId : this->pending) {
+		if (const auto it = this->nodeBounds.constFind(nodeId); it != this->nodeBounds.constEnd()) {
+			out = out ? unite(*out, *it) : *it;
+		}
+	}
+	return out.value_or(QRectF());
+}
+
+QList<SpatialIndex::NodeId> SpatialIndex::query(const QRectF& region) const {
+	this->flush();
+
+	QList<NodeId> out;
+	if (!this->levels.empty() && !this->levels.back().empty()) {
+		std::vector<std::pair<std::size_t, int>> stack{{this->levels.size() - 1, 0}};
+		while (!stack.empty()) {
+			const auto [level, index] = stack.back();
+			stack.pop_back();
+
+			const auto& treeNode = this->levels[level][index];
+			if (!overlaps(treeNode.bounds, region)) {
+				continue;
+			}
+			for (int i = treeNode.firstChild; i < treeNode.firstChild + treeNode.childCount; i++) {
+				if (level > 0) {
+					stack.emplace_back(level - 1, i);
+				} else if (const auto& entry = this->entries[i]; overlaps(entry.bounds, region) && !this->pending.contains(entry.nodeId)) {
+					out.push_back(entry.nodeId);
+				}
+			}
+		}
+	}
+	for (const auto nodeId : this->pending) {
+		if (const auto it = this->nodeBounds.constFind(nodeId); it != this->nodeBounds.constEnd() && overlaps(*it, region)) {
+			out.push_back(nodeId);
+		}
+	}
+	return out;
+}
+
+void SpatialIndex::visitClusters(qreal minExtent, const std::function<void(const QRectF& bounds)>& callback) const {
+	this->flush();
+
+	if (!this->levels.empty() && !this->levels.back().empty()) {
+		std::vector<std::pair<std::size_t, int>> stack{{this->levels.size() - 1, 0}};
+		while (!stack.empty()) {
+			const auto [level, index] = stack.back();
+			stack.pop_back();
+
+			const auto& treeNode = this->levels[level][index];
+			if (std::max(treeNode.bounds.width(), treeNode.bounds.height()) < minExtent) {
+				callback(treeNode.bounds);
+				continue;
+			}
+			for (int i = treeNode.firstChild; i < treeNode.firstChild + treeNode.childCount; i++) {
+				if (level > 0) {
+					stack.emplace_back(level - 1, i);
+				} else if (const auto& entry = this->entries[i]; !this->pending.contains(entry.nodeId)) {
+					callback(entry.bounds);
+				}
+			}
+		}
+	}
+	for (const auto nodeId : this->pending) {
+		if (const auto it = this->nodeBounds.constFind(nodeId); it != this->nodeBounds.constEnd()) {
+			callback(*it);
+		}
+	}
+}
+
+qint64 SpatialIndex::memoryUsage() const {
+	qint64 bytes = MemoryUsage::heap(this->nodeBounds) + MemoryUsage::heap(this->pending) + MemoryUsage::heap(this->entries) + MemoryUsage::heap(this->levels);
+	for (const auto& level : this->levels) {
+		bytes += MemoryUsage::heap(level);
+	}
+	return bytes;
+}
+
+void SpatialIndex::flush() const {
+	if (this->pending.size() > std::max(MIN_PENDING_BEFORE_PACK, this->nodeBounds.size() / 8)) {
+		this->pack();
+	}
+}
+
+void SpatialIndex::pack() const {
+	ENTGRAPH_TRACE_SCOPE("SpatialIndex::pack", "layout");
+	this->pending.clear();
+	this->entries.clear();
+	this->levels.clear();
+	if (this->nodeBounds.isEmpty()) {
+		return;
+	}
+
+	this->entries.reserve(this->nodeBounds.size());
+	for (const auto& [nodeId, bounds] : this->nodeBounds.asKeyValueRange()) {
+		this->entries.push_back({nodeId, bounds});
+	}
+	sortTileRecursive(this->entries);
+	this->levels.push_back(packLevel<Entry, TreeNode>(this->entries));
+
+	// Tiling a level reorders its nodes, but each one carries the range of children it owns, so that's fine
+	while (this->levels.back().size() > 1) {
+		sortTileRecursive(this->levels.back());
+		auto parents = packLevel<TreeNode, TreeNode>(this->levels.back());
+		this->levels.push_back(std::move(parents));
+	}
+}
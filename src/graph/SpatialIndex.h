@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <QHash>
+#include <QList>
+#include <QRectF>
+#include <QSet>
+
+#include <QtNodes/Definitions>
+
+/// R-tree over the bounding boxes of nodes, bulk loaded with sort-tile-recursive packing.
+/// Moving a node doesn't touch the tree: it goes into a small set of pending nodes that
+/// queries check on the side, and the tree is repacked on the next query once that set
+/// grows too large. Dragging nodes around stays O(1), and loading a map costs one repack.
+class SpatialIndex {
+public:
+	using NodeId = QtNodes::NodeId;
+
+	/// Children per tree node
+	static constexpr int MAX_CHILDREN = 16;
+
+	/// Adds a node, or moves it if it's already in the index
+	void insert(NodeId nodeId, const QRectF& bounds);
+
+	void remove(NodeId nodeId);
+
+	void clear();
+
+	[[nodiscard]] qsizetype size() const;
+
+	/// Bounds of every node in the index
+	[[nodiscard]] QRectF bounds() const;
+
+	/// Every node whose bounds intersect the given region
+	[[nodiscard]] QList<NodeId> query(const QRectF& region) const;
+
+	/// Calls back with the bounds of every node, except that groups of nodes smaller than
+	/// the given extent are merged into one rectangle. Lets overviews draw any number of
+	/// nodes in roughly as many calls as they have pixels
+	void visitClusters(qreal minExtent, const std::function<void(const QRectF& bounds)>& callback) const;
+
+	/// Approximate heap bytes held by the index and its tree
+	[[nodiscard]] qint64 memoryUsage() const;
+
+private:
+	struct Entry {
+		NodeId nodeId;
+		QRectF bounds;
+	};
+
+	struct TreeNode {
+		QRectF bounds;
+		/// Index into the level below, or into the entries for the bottom level
+		int firstChild;
+		int childCount;
+	};
+
+	/// Current bounds of every node
+	QHash<NodeId, QRectF> nodeBounds;
+
+	/// Nodes added, moved, or removed since the tree was packed. Checked linearly by queries
+	mutable QSet<NodeId> pending;
+
+	mutable std::vector<Entry> entries;
+
+	/// Bottom level first, the last level holds only the root
+	mutable std::vector<std::vector<TreeNode>> levels;
+
+	/// Repacks the tree if there are too many pending nodes to check one by one
+	void flush() const;
+
+	void pack() const;
+};
@@ -0,0 +1,170 @@
+#include "MapIndex.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+#include "../debug/MemoryReport.h"
+
+namespace {
+
+constexpr quint32 MAGIC = 0x4d494458; // "MIDX", QDataStream writes it big-endian
+
+} // namespace
+
+bool MapIndex::load(const QString& indexPath) {
+	this->clear();
+
+	QFile file(indexPath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_6_0);
+
+	quint32 magic = 0, version = 0;
+	in >> magic >> version;
+	if (magic != MAGIC || version != VERSION) {
+		return false;
+	}
+	qint64 count = 0;
+	in >> count;
+	for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		MapIndexEntry entry;
+		in >> entry.path >> entry.game >> entry.modified >> entry.size >> entry.hash >> entry.classnames >> entry.targetnames;
+		if (in.status() == QDataStream::Ok) {
+			this->insert(std::move(entry));
+		}
+	}
+	if (in.status() != QDataStream::Ok) {
+		this->clear();
+		return false;
+	}
+	return true;
+}
+
+bool MapIndex::save(const QString& indexPath) const {
+	QSaveFile file(indexPath);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_6_0);
+
+	out << MAGIC << VERSION << static_cast<qint64>(this->entries.size());
+	for (const auto& entry : this->entries) {
+		out << entry.path << entry.game << entry.modified << entry.size << entry.hash << entry.classnames << entry.targetnames;
+	}
+	return out.status() == QDataStream::Ok && file.commit();
+}
+
+const MapIndexEntry* MapIndex::find(const QString& mapPath) const {
+	const auto it = this->entries.constFind(mapPath);
+	return it != this->entries.constEnd() ? &*it : nullptr;
+}
+
+void MapIndex::insert(MapIndexEntry entry) {
+	if (const auto it = this->entries.constFind(entry.path); it != this->entries.constEnd()) {
+		this->removeFromLookups(*it);
+	}
+	this->addToLookups(entry);
+	this->entries.insert(entry.path, std::move(entry));
+}
+
+void MapIndex::retain(const QSet<QString>& mapPaths) {
+	for (auto it = this->entries.begin(); it != this->entries.end();) {
+		if (mapPaths.contains(it.key())) {
+			++it;
+			continue;
+		}
+		this->removeFromLookups(*it);
+		it = this->entries.erase(it);
+	}
+}
+
+void MapIndex::clear() {
+	this->entries.clear();
+	this->mapsByClassname.clear();
+	this->mapsByTargetname.clear();
+}
+
+qsizetype MapIndex::size() const {
+	return this->entries.size();
+}
+
+qint64 MapIndex::memoryUsage() const {
+	const auto namesUsage = [](const QHash<QString, int>& names) {
+		qint64 bytes = MemoryUsage::heap(names);
+		for (const auto& name : names.keys()) {
+			bytes += MemoryUsage::heap(name);
+		}
+		return bytes;
+	};
+	const auto lookupUsage = [&namesUsage](const QHash<QString, QHash<QString, int>>& lookup) {
+		qint64 bytes = MemoryUsage::heap(lookup);
+		for (const auto& [name, maps] : lookup.asKeyValueRange()) {
+			bytes += MemoryUsage::heap(name) + namesUsage(maps);
+		}
+		return bytes;
+	};
+
+	qint64 bytes = MemoryUsage::heap(this->entries);
+	// Keys share their string with the entry's path
+	for (const auto& entry : this->entries) {
+		bytes += MemoryUsage::heap(entry.path) + MemoryUsage::heap(entry.game) + MemoryUsage::heap(entry.hash) + namesUsage(entry.classnames) + namesUsage(entry.targetnames);
+	}
+	return bytes + lookupUsage(this->mapsByClassname) + lookupUsage(this->mapsByTargetname);
+}
+
+QList<MapIndex::Match> MapIndex::findClassname(const QString& classname) const {
+	return this->matches(this->mapsByClassname, classname);
+}
+
+QList<MapIndex::Match> MapIndex::findTargetname(const QString& targetname) const {
+	return this->matches(this->mapsByTargetname, targetname);
+}
+
+void MapIndex::addToLookups(const MapIndexEntry& entry) {
+	for (const auto& [classname, count] : entry.classnames.asKeyValueRange()) {
+		this->mapsByClassname[classname].insert(entry.path, count);
+	}
+	for (const auto& [targetname, count] : entry.targetnames.asKeyValueRange()) {
+		this->mapsByTargetname[targetname].insert(entry.path, count);
+	}
+}
+
+void MapIndex::removeFromLookups(const MapIndexEntry& entry) {
+	const auto remove = [&entry](QHash<QString, QHash<QString, int>>& lookup, const QHash<QString, int>& names) {
+		for (const auto& name : names.keys()) {
+			auto it = lookup.find(name);
+			if (it == lookup.end()) {
+				continue;
+			}
+			it->remove(entry.path);
+			if (it->isEmpty()) {
+				lookup.erase(it);
+			}
+		}
+	};
+	remove(this->mapsByClassname, entry.classnames);
+	remove(this->mapsByTargetname, entry.targetnames);
+}
+
+QList<MapIndex::Match> MapIndex::matches(const QHash<QString, QHash<QString, int>>& lookup, const QString& name) const {
+	QList<Match> out;
+	const auto it = lookup.constFind(name.toLower());
+	if (it == lookup.constEnd()) {
+		return out;
+	}
+	out.reserve(it->size());
+	for (const auto& [path, count] : it->asKeyValueRange()) {
+		const auto* entry = this->find(path);
+		out.push_back({path, entry ? entry->game : QString(), count});
+	}
+	std::sort(out.begin(), out.end(), [](const Match& lhs, const Match& rhs) {
+		return lhs.count != rhs.count ? lhs.count > rhs.count : lhs.path < rhs.path;
+	});
+	return out;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+
+struct MapIndexEntry {
+	QString path;
+	QString game;
+	qint64 modified;
+	qint64 size;
+	/// Hash of the data the entities were read from, to skip reparsing files that were touched but not changed
+	QByteArray hash;
+	/// Lowercased names, and how many entities use them
+	QHash<QString, int> classnames;
+	QHash<QString, int> targetnames;
+};
+
+/// Which maps use which entity classnames and targetnames, kept in both directions
+/// so lookups only touch the maps that match.
+class MapIndex {
+public:
+	struct Match {
+		QString path;
+		QString game;
+		int count;
+	};
+
+	static constexpr quint32 VERSION = 1;
+
+	bool load(const QString& indexPath);
+
+	bool save(const QString& indexPath) const;
+
+	[[nodiscard]] const MapIndexEntry* find(const QString& mapPath) const;
+
+	/// Adds an entry, replacing any existing entry for the same map
+	void insert(MapIndexEntry entry);
+
+	/// Drops every map that isn't in the given set
+	void retain(const QSet<QString>& mapPaths);
+
+	void clear();
+
+	[[nodiscard]] qsizetype size() const;
+
+	/// Approximate heap bytes held by the entries and both lookups
+	[[nodiscard]] qint64 memoryUsage() const;
+
+	/// Case-insensitive. Sorted by how many entities match, highest first
+	[[nodiscard]] QList<Match> findClassname(const QString& classname) const;
+
+	/// Case-insensitive. Sorted by how many entities match, highest first
+	[[nodiscard]] QList<Match> findTargetname(const QString& targetname) const;
+
+private:
+	QHash<QString, MapIndexEntry> entries;
+
+	/// Lowercased name -> map path -> entity count
+	QHash<QString, QHash<QString, int>> mapsByClassname;
+	QHash<QString, QHash<QString, int>> mapsByTargetname;
+
+	void addToLookups(const MapIndexEntry& entry);
+
+	void removeFromLookups(const MapIndexEntry& entry);
+
+	[[nodiscard]] QList<Match> matches(const QHash<QString, QHash<QString, int>>& lookup, const QString& name) const;
+};
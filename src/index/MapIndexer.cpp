@@ -0,0 +1,260 @@
+#include "MapIndexer.h"
+
+#include <exception>
+#include <memory>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+
+#include <FilesystemSearchProvider.h>
+
+#include "../debug/MemoryReport.h"
+#include "../debug/Trace.h"
+#include "../wrapper/BSPWrapper.h"
+#include "../wrapper/VMFWrapper.h"
+
+namespace {
+
+/// How far below a game's install folder to look for maps and mapsrc folders
+constexpr int MAX_SEARCH_DEPTH = 3;
+
+/// Don't flood the UI thread with one signal per map
+constexpr int PROGRESS_INTERVAL = 16;
+
+/// Save every so many maps, so a long first scan that gets cut short doesn't have to start over
+constexpr int SAVE_INTERVAL = 512;
+
+} // namespace
+
+MapIndexer::MapIndexer(const QString& indexPath_, QObject* parent)
+		: QObject(parent)
+		, indexPath(indexPath_)
+		, indexLoaded(false)
+		, thread(nullptr)
+		, cancelled(false) {}
+
+MapIndexer::~MapIndexer() {
+	this->cancelled = true;
+	if (this->thread) {
+		this->thread->wait();
+		delete this->thread;
+	}
+}
+
+void MapIndexer::start() {
+	if (this->isRunning()) {
+		return;
+	}
+	delete this->thread;
+	this->cancelled = false;
+	this->thread = QThread::create([this] {
+		this->run();
+	});
+	this->thread->start(QThread::LowPriority);
+}
+
+bool MapIndexer::isRunning() const {
+	return this->thread && this->thread->isRunning();
+}
+
+qsizetype MapIndexer::mapCount() const {
+	QMutexLocker lock(&this->indexMutex);
+	return this->index.size();
+}
+
+void MapIndexer::reportMemory(MemoryReport& report) const {
+	QMutexLocker lock(&this->indexMutex);
+	report.add("Map index", "Installed maps", this->index.memoryUsage(), this->index.size());
+}
+
+QList<MapIndex::Match> MapIndexer::findClassname(const QString& classname) const {
+	QMutexLocker lock(&this->indexMutex);
+	return this->index.findClassname(classname);
+}
+
+QList<MapIndex::Match> MapIndexer::findTargetname(const QString& targetname) const {
+	QMutexLocker lock(&this->indexMutex);
+	return this->index.findTargetname(targetname);
+}
+
+QList<MapIndexer::MapDirectory> MapIndexer::findMapDirectories() {
+	QList<MapDirectory> directories;
+
+	CFileSystemSearchProvider provider;
+	if (!provider.Available()) {
+		return directories;
+	}
+	const auto installedAppCount = provider.GetNumInstalledApps();
+	std::unique_ptr<uint32_t[]> appIds(provider.GetInstalledApps());
+	for (int i = 0; i < installedAppCount; i++) {
+		if (!provider.BIsSourceGame(appIds[i])) {
+			continue;
+		}
+		std::unique_ptr<CFileSystemSearchProvider::GameInfo> gameInfo(provider.GetAppInstallDir(appIds[i]));
+		if (!gameInfo) {
+			continue;
+		}
+
+		// Usually <game>/<mod>/maps, <game>/sdk_content/maps or <game>/bin/mapsrc
+		QList<QPair<QString, int>> queue{{QString(gameInfo->library) + "/common/" + gameInfo->installDir, 0}};
+		while (!queue.isEmpty()) {
+			const auto [directory, depth] = queue.takeFirst();
+			for (const auto& child : QDir(directory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+				const auto name = child.fileName().toLower();
+				if (name == "maps" || name == "mapsrc") {
+					directories.push_back({gameInfo->gameName, child.absoluteFilePath()});
+				} else if (depth < MAX_SEARCH_DEPTH) {
+					queue.push_back({child.absoluteFilePath(), depth + 1});
+				}
+			}
+		}
+	}
+	return directories;
+}
+
+void MapIndexer::run() {
+	if (!this->indexLoaded) {
+		QMutexLocker lock(&this->indexMutex);
+		this->index.load(this->indexPath);
+		this->indexLoaded = true;
+	}
+
+	struct MapFile {
+		QString path;
+		QString game;
+	};
+	QList<MapFile> files;
+	QSet<QString> seen;
+	for (const auto& directory : findMapDirectories()) {
+		QDirIterator it(directory.path, {"*.vmf", "*.bsp"}, QDir::Files, QDirIterator::Subdirectories);
+		while (it.hasNext() && !this->cancelled) {
+			auto path = QFileInfo(it.next()).absoluteFilePath();
+			if (!seen.contains(path)) {
+				seen.insert(path);
+				files.push_back({std::move(path), directory.game});
+			}
+		}
+	}
+	if (this->cancelled) {
+		return;
+	}
+
+	const auto total = static_cast<int>(files.size());
+	std::atomic_int scanned = 0;
+	QThreadPool pool;
+	for (const auto& file : files) {
+		pool.start([this, file, total, &scanned, &seen] {
+			if (this->cancelled) {
+				return;
+			}
+			const QFileInfo info(file.path);
+			const auto modified = info.lastModified().toMSecsSinceEpoch();
+
+			MapIndexEntry previous;
+			bool hasPrevious = false;
+			{
+				QMutexLocker lock(&this->indexMutex);
+				if (const auto* existing = this->index.find(file.path)) {
+					previous = *existing;
+					hasPrevious = true;
+				}
+			}
+			if (!hasPrevious || previous.modified != modified || previous.size != info.size() || previous.game != file.game) {
+				MapIndexEntry entry{.path = file.path, .game = file.game, .modified = modified, .size = info.size()};
+				if (scan(file.path, entry, hasPrevious ? &previous : nullptr)) {
+					QMutexLocker lock(&this->indexMutex);
+					this->index.insert(std::move(entry));
+				}
+			}
+
+			const auto done = ++scanned;
+			if (done % PROGRESS_INTERVAL == 0 || done == total) {
+				Q_EMIT this->progress(done, total);
+			}
+			if (done % SAVE_INTERVAL == 0 && done != total) {
+				this->saveIndex(seen);
+			}
+		});
+	}
+	pool.waitForDone();
+
+	// Keep whatever was scanned before a cancel, every map still on disk was seen by now either way
+	this->saveIndex(seen);
+	if (!this->cancelled) {
+		Q_EMIT this->finished();
+	}
+}
+
+void MapIndexer::saveIndex(const QSet<QString>& seen) {
+	QMutexLocker lock(&this->indexMutex);
+	this->index.retain(seen);
+	QDir().mkpath(QFileInfo(this->indexPath).absolutePath());
+	this->index.save(this->indexPath);
+}
+
+bool MapIndexer::scan(const QString& path, MapIndexEntry& entry, const MapIndexEntry* previous) {
+	ENTGRAPH_TRACE_SCOPE("MapIndexer::scan", "io");
+	const auto reusePrevious = [&entry, previous] {
+		if (!previous || previous->hash != entry.hash) {
+			return false;
+		}
+		entry.classnames = previous->classnames;
+		entry.targetnames = previous->targetnames;
+		return true;
+	};
+
+	// These run on whatever junk is lying around in a game install, so don't let one bad map take us down
+	try {
+		QList<EntityKV> entities;
+		if (path.endsWith(".bsp", Qt::CaseInsensitive)) {
+			// Hash the raw lump first, most maps haven't changed and don't need parsing at all
+			qint64 bytesRead = 0;
+			const auto lump = BSPEntityKVParser::readEntityLump(path, &bytesRead);
+			if (lump.isEmpty()) {
+				return false;
+			}
+			entry.hash = QCryptographicHash::hash(lump, QCryptographicHash::Md5);
+			if (reusePrevious()) {
+				return true;
+			}
+			BSPEntityKVParser parser{lump, bytesRead};
+			if (!parser) {
+				return false;
+			}
+			entities = parser.getEntities();
+		} else {
+			QFile file(path);
+			if (!file.open(QIODevice::ReadOnly)) {
+				return false;
+			}
+			const auto contents = file.readAll();
+			file.close();
+			entry.hash = QCryptographicHash::hash(contents, QCryptographicHash::Md5);
+			if (reusePrevious()) {
+				return true;
+			}
+			EntityKVParser parser{QString::fromUtf8(contents)};
+			if (!parser) {
+				return false;
+			}
+			entities = parser.getEntities();
+		}
+
+		for (const auto& entity : entities) {
+			entry.classnames[entity.classname.toLower()]++;
+			if (!entity.targetname.isEmpty()) {
+				entry.targetnames[entity.targetname.toLower()]++;
+			}
+		}
+		return true;
+	} catch (const std::exception&) {
+		return false;
+	}
+}
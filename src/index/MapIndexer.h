@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+
+#include <QMutex>
+#include <QObject>
+
+#include "MapIndex.h"
+
+class MemoryReport;
+class QThread;
+
+/// Keeps a MapIndex of every VMF and BSP in the installed Source games up to date.
+/// Scanning happens on a thread pool in the background, and only maps whose size or
+/// modification time changed since the last run are read again.
+class MapIndexer : public QObject {
+	Q_OBJECT;
+
+public:
+	struct MapDirectory {
+		QString game;
+		QString path;
+	};
+
+	explicit MapIndexer(const QString& indexPath_, QObject* parent = nullptr);
+
+	~MapIndexer() override;
+
+	/// Loads the saved index if needed, then starts updating it. Does nothing if it's already updating
+	void start();
+
+	[[nodiscard]] bool isRunning() const;
+
+	[[nodiscard]] qsizetype mapCount() const;
+
+	void reportMemory(MemoryReport& report) const;
+
+	[[nodiscard]] QList<MapIndex::Match> findClassname(const QString& classname) const;
+
+	[[nodiscard]] QList<MapIndex::Match> findTargetname(const QString& targetname) const;
+
+	/// The maps and mapsrc folders of every installed Source game
+	[[nodiscard]] static QList<MapDirectory> findMapDirectories();
+
+Q_SIGNALS:
+	void progress(int scanned, int total);
+
+	void finished();
+
+private:
+	QString indexPath;
+	MapIndex index;
+	mutable QMutex indexMutex;
+	bool indexLoaded;
+
+	QThread* thread;
+	std::atomic_bool cancelled;
+
+	void run();
+
+	/// Drops maps that weren't found this run, then writes the index to disk
+	void saveIndex(const QSet<QString>& seen);
+
+	/// Reads the map's entities into the entry, or returns false if it couldn't be read
+	static bool scan(const QString& path, MapIndexEntry& entry, const MapIndexEntry* previous);
+};
@@ -0,0 +1,88 @@
+#include "MapSearchDialog.h"
+
+#include <QComboBox>
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "MapIndexer.h"
+
+MapSearchDialog::MapSearchDialog(MapIndexer* indexer_, QWidget* parent)
+		: QDialog(parent)
+		, indexer(indexer_) {
+	this->setWindowTitle(tr("Search Installed Maps"));
+	this->setMinimumSize(700, 400);
+
+	auto* layout = new QVBoxLayout(this);
+
+	auto* searchLayout = new QHBoxLayout;
+	this->searchType = new QComboBox(this);
+	this->searchType->addItem(tr("Classname"));
+	this->searchType->addItem(tr("Targetname"));
+	searchLayout->addWidget(this->searchType);
+	this->searchBox = new QLineEdit(this);
+	this->searchBox->setPlaceholderText(tr("point_template"));
+	this->searchBox->setClearButtonEnabled(true);
+	searchLayout->addWidget(this->searchBox, 1);
+	layout->addLayout(searchLayout);
+
+	this->results = new QTreeWidget(this);
+	this->results->setHeaderLabels({tr("Map"), tr("Game"), tr("Entities")});
+	this->results->setRootIsDecorated(false);
+	this->results->setSortingEnabled(false);
+	this->results->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+	layout->addWidget(this->results, 1);
+
+	this->status = new QLabel(this);
+	layout->addWidget(this->status);
+
+	QObject::connect(this->searchBox, &QLineEdit::textChanged, this, &MapSearchDialog::search);
+	QObject::connect(this->searchType, &QComboBox::currentIndexChanged, this, &MapSearchDialog::search);
+	QObject::connect(this->results, &QTreeWidget::itemActivated, this, [this](QTreeWidgetItem* item) {
+		Q_EMIT this->mapActivated(item->text(0));
+	});
+	QObject::connect(this->indexer, &MapIndexer::progress, this, [this](int scanned, int total) {
+		this->updateStatus(tr("Indexing %1/%2 maps...").arg(scanned).arg(total));
+	});
+	QObject::connect(this->indexer, &MapIndexer::finished, this, [this] {
+		this->updateStatus();
+		this->search();
+	});
+
+	this->updateStatus(this->indexer->isRunning() ? tr("Indexing...") : QString());
+}
+
+void MapSearchDialog::search() {
+	this->results->clear();
+	const auto query = this->searchBox->text().trimmed();
+	if (query.isEmpty()) {
+		this->updateStatus(this->indexer->isRunning() ? tr("Indexing...") : QString());
+		return;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	const auto matches = this->searchType->currentIndex() == 0 ? this->indexer->findClassname(query) : this->indexer->findTargetname(query);
+	const auto elapsed = timer.nsecsElapsed();
+
+	QList<QTreeWidgetItem*> items;
+	items.reserve(matches.size());
+	for (const auto& match : matches) {
+		items.push_back(new QTreeWidgetItem({match.path, match.game, QString::number(match.count)}));
+	}
+	this->results->addTopLevelItems(items);
+
+	this->updateStatus(tr("%n map(s) found in %1 ms.", "", static_cast<int>(matches.size())).arg(static_cast<double>(elapsed) / 1e6, 0, 'f', 2));
+}
+
+void MapSearchDialog::updateStatus(const QString& prefix) {
+	auto text = tr("%n map(s) indexed.", "", static_cast<int>(this->indexer->mapCount()));
+	if (!prefix.isEmpty()) {
+		text = prefix + ' ' + text;
+	}
+	this->status->setText(text);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QDialog>
+
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QTreeWidget;
+
+class MapIndexer;
+
+class MapSearchDialog : public QDialog {
+	Q_OBJECT;
+
+public:
+	explicit MapSearchDialog(MapIndexer* indexer_, QWidget* parent = nullptr);
+
+Q_SIGNALS:
+	void mapActivated(const QString& path);
+
+private:
+	MapIndexer* indexer;
+
+	QComboBox* searchType;
+	QLineEdit* searchBox;
+	QTreeWidget* results;
+	QLabel* status;
+
+	void search();
+
+	void updateStatus(const QString& prefix = QString());
+};
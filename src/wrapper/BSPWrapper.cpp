@@ -0,0 +1,246 @@
+#include "BSPWrapper.h"
+
+#include <array>
+#include <cstring>
+
+#include <QFile>
+#include <QSet>
+#include <QtEndian>
+
+#include <KeyValue.h>
+
+#include "../debug/Trace.h"
+#include "LZMA.h"
+
+namespace {
+
+constexpr qsizetype BSP_LUMP_COUNT = 64;
+constexpr qsizetype BSP_LUMP_SIZE = 16;
+constexpr qsizetype BSP_HEADER_SIZE = 8 + BSP_LUMP_COUNT * BSP_LUMP_SIZE + 4;
+constexpr qsizetype BSP_LUMP_ENTITIES = 0;
+constexpr qint32 BSP_VERSION_L4D2 = 21;
+
+/// "LZMA", actual size, compressed size, then the 5 LZMA property bytes
+constexpr qsizetype LZMA_LUMP_HEADER_SIZE = 12 + LZMA::PROPERTIES_SIZE;
+
+/// The decompressed size comes from the file, so it's checked against these before anything is allocated.
+/// Entity text rarely compresses better than 20:1, and the largest shipped maps have lumps of a few MiB
+constexpr quint64 MAX_LZMA_RATIO = 128;
+constexpr quint64 MAX_ENTITY_LUMP_SIZE = 256 * 1024 * 1024;
+
+QByteArray readEntityLumpFrom(QFile& file, qint64& bytesRead) {
+	const auto header = file.read(BSP_HEADER_SIZE);
+	bytesRead = header.size();
+	if (header.size() != BSP_HEADER_SIZE || !header.startsWith("VBSP")) {
+		return {};
+	}
+	const auto version = qFromLittleEndian<qint32>(header.constData() + 4);
+	const char* lump = header.constData() + 8 + BSP_LUMP_ENTITIES * BSP_LUMP_SIZE;
+	qint64 offset = qFromLittleEndian<qint32>(lump);
+	qint64 length = qFromLittleEndian<qint32>(lump + 4);
+	if (version == BSP_VERSION_L4D2 && offset < BSP_HEADER_SIZE) {
+		// Left 4 Dead 2 moved the lump version to the front: {version, offset, length, fourCC}
+		offset = qFromLittleEndian<qint32>(lump + 4);
+		length = qFromLittleEndian<qint32>(lump + 8);
+	}
+	if (offset < BSP_HEADER_SIZE || length <= 0 || offset + length > file.size() || !file.seek(offset)) {
+		return {};
+	}
+
+	auto data = file.read(length);
+	bytesRead += data.size();
+	if (data.size() != length) {
+		return {};
+	}
+	if (data.size() < LZMA_LUMP_HEADER_SIZE || !data.startsWith("LZMA")) {
+		return data;
+	}
+
+	const auto actualSize = qFromLittleEndian<quint32>(data.constData() + 4);
+	const auto lzmaSize = qFromLittleEndian<quint32>(data.constData() + 8);
+	if (lzmaSize > static_cast<quint64>(data.size() - LZMA_LUMP_HEADER_SIZE)) {
+		return {};
+	}
+	if (actualSize == 0 || actualSize > MAX_ENTITY_LUMP_SIZE || actualSize > static_cast<quint64>(lzmaSize) * MAX_LZMA_RATIO) {
+		return {};
+	}
+	QByteArray decompressed(actualSize, Qt::Uninitialized);
+	if (!LZMA::decompress(
+			reinterpret_cast<const std::uint8_t*>(data.constData() + 12),
+			reinterpret_cast<const std::uint8_t*>(data.constData() + LZMA_LUMP_HEADER_SIZE), lzmaSize,
+			reinterpret_cast<std::uint8_t*>(decompressed.data()), actualSize)) {
+		return {};
+	}
+	return decompressed;
+}
+
+/// The entity lump is a list of bare { } blocks, but KeyValues wants a key in front of each one
+QByteArray keyEntityBlocks(QByteArrayView lump) {
+	QByteArray out;
+	out.reserve(lump.size() + lump.size() / 8);
+	bool quoted = false;
+	int depth = 0;
+	for (const char c : lump) {
+		if (c == '\0') {
+			break;
+		}
+		if (c == '"') {
+			quoted = !quoted;
+		} else if (!quoted && c == '{') {
+			if (depth++ == 0) {
+				out += "\"entity\" ";
+			}
+		} else if (!quoted && c == '}') {
+			depth--;
+		}
+		out += c;
+	}
+	return out;
+}
+
+/// Compiled maps store outputs as plain keyvalues, so anything shaped like
+/// "target,input,parameter,delay,times" (or separated by 0x1b) is treated as a connection
+bool parseConnection(QByteArrayView output, QByteArrayView value, EntityConnectionKV& connection) {
+	const char separator = std::memchr(value.data(), 0x1b, value.size()) ? '\x1b' : ',';
+	std::array<QByteArrayView, 5> parts;
+	qsizetype count = 0;
+	qsizetype start = 0;
+	for (qsizetype i = 0; i <= value.size(); i++) {
+		if (i != value.size() && value[i] != separator) {
+			continue;
+		}
+		if (count == static_cast<qsizetype>(parts.size())) {
+			return false;
+		}
+		parts[count++] = value.sliced(start, i - start);
+		start = i + 1;
+	}
+	if (count != static_cast<qsizetype>(parts.size())) {
+		return false;
+	}
+
+	bool delayValid = false;
+	bool fireAmountValid = false;
+	QString::fromUtf8(parts[3]).toFloat(&delayValid);
+	const auto fireAmount = QString::fromUtf8(parts[4]).toInt(&fireAmountValid);
+	if (!delayValid || !fireAmountValid) {
+		return false;
+	}
+
+	connection.output = QString::fromUtf8(output);
+	connection.targetname = QString::fromUtf8(parts[0]);
+	connection.input = QString::fromUtf8(parts[1]);
+	connection.parameter = QString::fromUtf8(parts[2]);
+	connection.delay = QString::fromUtf8(parts[3]);
+	connection.fireAmount = fireAmount;
+	return true;
+}
+
+QByteArrayView view(const kvString_t& str) {
+	return {str.string, static_cast<qsizetype>(str.length)};
+}
+
+} // namespace
+
+BSPEntityKVParser::BSPEntityKVParser(const QString& path)
+		: bytesRead(0)
+		, valid(false) {
+	ENTGRAPH_TRACE_SCOPE("BSPEntityKVParser::BSPEntityKVParser", "io");
+	this->parse(readEntityLump(path, &this->bytesRead));
+}
+
+BSPEntityKVParser::BSPEntityKVParser(const QByteArray& lump, qint64 bytesRead_)
+		: bytesRead(bytesRead_)
+		, valid(false) {
+	this->parse(lump);
+}
+
+BSPEntityKVParser::~BSPEntityKVParser() = default;
+
+bool BSPEntityKVParser::isValid() const {
+	return this->valid;
+}
+
+BSPEntityKVParser::operator bool() const {
+	return this->isValid();
+}
+
+QList<EntityKV> BSPEntityKVParser::getEntities() const {
+	ENTGRAPH_TRACE_SCOPE("BSPEntityKVParser::getEntities", "parse");
+	QList<EntityKV> entities;
+	if (!this->valid) {
+		return entities;
+	}
+
+	// Compiled maps only keep Hammer's ids in "hammerid", and not every entity has one
+	QSet<int> usedIds;
+	QList<qsizetype> entitiesWithoutId;
+
+	entities.reserve(static_cast<qsizetype>(this->root->childCount));
+	for (size_t i = 0; i < this->root->childCount; i++) {
+		auto& entity = this->root->At(i);
+		EntityKV entData{};
+		entData.id = -1;
+		for (size_t j = 0; j < entity.childCount; j++) {
+			auto& kv = entity.At(j);
+			const auto key = view(kv.key);
+			const auto value = view(kv.value);
+			if (key.compare("classname", Qt::CaseInsensitive) == 0) {
+				entData.classname = QString::fromUtf8(value);
+			} else if (key.compare("targetname", Qt::CaseInsensitive) == 0) {
+				entData.targetname = QString::fromUtf8(value);
+			} else if (key.compare("hammerid", Qt::CaseInsensitive) == 0) {
+				bool ok = false;
+				const auto id = QString::fromUtf8(value).toInt(&ok);
+				if (ok && !usedIds.contains(id)) {
+					entData.id = id;
+					usedIds.insert(id);
+				}
+			} else if (EntityConnectionKV connection; parseConnection(key, value, connection)) {
+				entData.connections.push_back(connection);
+			}
+		}
+		if (entData.id < 0) {
+			entitiesWithoutId.push_back(entities.size());
+		}
+		entities.push_back(entData);
+	}
+
+	int nextId = 1;
+	for (const auto index : entitiesWithoutId) {
+		while (usedIds.contains(nextId)) {
+			nextId++;
+		}
+		entities[index].id = nextId++;
+	}
+	return entities;
+}
+
+qint64 BSPEntityKVParser::getBytesRead() const {
+	return this->bytesRead;
+}
+
+const QByteArray& BSPEntityKVParser::getEntityLump() const {
+	return this->text;
+}
+
+QByteArray BSPEntityKVParser::readEntityLump(const QString& path, qint64* bytesRead) {
+	qint64 read = 0;
+	QByteArray lump;
+	if (QFile file(path); file.open(QIODevice::ReadOnly)) {
+		lump = readEntityLumpFrom(file, read);
+	}
+	if (bytesRead) {
+		*bytesRead = read;
+	}
+	return lump;
+}
+
+void BSPEntityKVParser::parse(const QByteArray& lump) {
+	if (lump.isEmpty()) {
+		return;
+	}
+	this->text = keyEntityBlocks(lump);
+	this->root = std::make_unique<KeyValueRoot>();
+	this->valid = this->root->Parse(this->text.constData()) == KeyValueErrorCode::NO_ERROR;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "VMFWrapper.h"
+
+class KeyValueRoot;
+
+/// Reads entities straight out of a compiled map. Only the header and the entity lump are
+/// read from disk, so this stays cheap no matter how large the rest of the BSP is.
+class BSPEntityKVParser {
+public:
+	explicit BSPEntityKVParser(const QString& path);
+
+	/// Parses a lump that was already read with readEntityLump
+	BSPEntityKVParser(const QByteArray& lump, qint64 bytesRead_);
+
+	~BSPEntityKVParser();
+
+	[[nodiscard]] bool isValid() const;
+
+	[[nodiscard]] explicit operator bool() const;
+
+	[[nodiscard]] QList<EntityKV> getEntities() const;
+
+	/// Number of bytes read from the BSP, before decompression
+	[[nodiscard]] qint64 getBytesRead() const;
+
+	/// The decompressed entity lump as it was handed to the parser
+	[[nodiscard]] const QByteArray& getEntityLump() const;
+
+	/// Reads and decompresses the entity lump without parsing it, so callers can check
+	/// whether it changed first. Returns an empty array if the file isn't a valid BSP
+	[[nodiscard]] static QByteArray readEntityLump(const QString& path, qint64* bytesRead = nullptr);
+
+private:
+	/// Entity lump text, kept alive for as long as the parsed tree
+	QByteArray text;
+	std::unique_ptr<KeyValueRoot> root;
+	qint64 bytesRead;
+	bool valid;
+
+	void parse(const QByteArray& lump);
+};
@@ -0,0 +1,234 @@
+#include "InstanceResolver.h"
+
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThreadPool>
+
+#include "../debug/MemoryReport.h"
+#include "../debug/Trace.h"
+
+namespace {
+
+constexpr QStringView INSTANCE_INPUT_PREFIX = u"instance:";
+
+QString applyReplacements(QString value, const QList<QPair<QString, QString>>& replacements) {
+	if (replacements.isEmpty() || !value.contains('$')) {
+		return value;
+	}
+	for (const auto& [variable, replacement] : replacements) {
+		value.replace(variable, replacement, Qt::CaseInsensitive);
+	}
+	return value;
+}
+
+QString fixupName(const QString& name, const QString& instanceName, EntityInstanceKV::FixupStyle style) {
+	// Names starting with @ are global, and ! names (like !activator) are resolved by the engine
+	if (name.isEmpty() || name.startsWith('@') || name.startsWith('!')) {
+		return name;
+	}
+	switch (style) {
+		case EntityInstanceKV::FIXUP_PREFIX:
+			return instanceName + '-' + name;
+		case EntityInstanceKV::FIXUP_POSTFIX:
+			return name + '-' + instanceName;
+		case EntityInstanceKV::FIXUP_NONE:
+			break;
+	}
+	return name;
+}
+
+} // namespace
+
+QList<EntityKV> InstanceResolver::resolve(const QString& mapPath, const QList<EntityKV>& entities, const QList<EntityInstanceKV>& instances) {
+	ENTGRAPH_TRACE_SCOPE("InstanceResolver::resolve", "parse");
+	const auto absoluteMapPath = QFileInfo(mapPath).absoluteFilePath();
+
+	ExpandState state;
+	state.nextAutoName = 1;
+	state.nextId = 1;
+	for (const auto& entity : entities) {
+		state.nextId = std::max(state.nextId, entity.id + 1);
+	}
+
+	// Find every file we need one level of nesting at a time, parsing each level in parallel
+	QStringList pending;
+	for (const auto& instance : instances) {
+		if (auto path = resolveInstancePath(absoluteMapPath, instance.file); !path.isEmpty() && !pending.contains(path)) {
+			pending.push_back(path);
+		}
+	}
+	for (int depth = 0; depth < MAX_DEPTH && !pending.isEmpty(); depth++) {
+		const auto parsed = this->parseAll(pending);
+		state.files.insert(parsed);
+
+		QStringList next;
+		for (const auto& [path, file] : parsed.asKeyValueRange()) {
+			for (const auto& instance : file->instances) {
+				if (auto childPath = resolveInstancePath(path, instance.file); !childPath.isEmpty() && !state.files.contains(childPath) && !next.contains(childPath)) {
+					next.push_back(childPath);
+				}
+			}
+		}
+		pending = std::move(next);
+	}
+
+	// Then lay out the entities, which is cheap compared to parsing
+	ENTGRAPH_TRACE_SCOPE("InstanceResolver::expand", "parse");
+	state.out = entities;
+	state.stack.push_back(absoluteMapPath);
+	this->expand(state, absoluteMapPath, instances, {QString(), EntityInstanceKV::FIXUP_NONE, {}, QString()});
+
+	// Outside entities talk to an instance's entities through "instance:name;Input" on the func_instance
+	for (auto& entity : state.out) {
+		for (auto& connection : entity.connections) {
+			if (!connection.input.startsWith(INSTANCE_INPUT_PREFIX, Qt::CaseInsensitive)) {
+				continue;
+			}
+			const auto it = state.instancesByName.constFind(connection.targetname.toLower());
+			const auto split = connection.input.indexOf(';');
+			if (it == state.instancesByName.constEnd() || split < 0) {
+				continue;
+			}
+			const auto innerName = connection.input.mid(INSTANCE_INPUT_PREFIX.size(), split - INSTANCE_INPUT_PREFIX.size());
+			connection.targetname = fixupName(innerName, it->name, it->style);
+			connection.input = connection.input.mid(split + 1);
+		}
+	}
+	return state.out;
+}
+
+void InstanceResolver::clearCache() {
+	QMutexLocker lock(&this->parsedByHashMutex);
+	this->parsedByHash.clear();
+}
+
+void InstanceResolver::reportMemory(MemoryReport& report) const {
+	QMutexLocker lock(&this->parsedByHashMutex);
+	qint64 bytes = MemoryUsage::heap(this->parsedByHash);
+	for (const auto& [hash, parsed] : this->parsedByHash.asKeyValueRange()) {
+		bytes += MemoryUsage::heap(hash) + static_cast<qint64>(sizeof(ParsedInstance)) + entityMemoryUsage(parsed->entities) + instanceMemoryUsage(parsed->instances);
+	}
+	report.add("Instances", "Parsed instance cache", bytes, this->parsedByHash.size());
+}
+
+QHash<QString, InstanceResolver::ParsedInstancePtr> InstanceResolver::parseAll(const QStringList& paths) {
+	QHash<QString, ParsedInstancePtr> results;
+	QMutex resultsMutex;
+
+	QThreadPool pool;
+	for (const auto& path : paths) {
+		pool.start([this, path, &results, &resultsMutex] {
+			ENTGRAPH_TRACE_SCOPE("InstanceResolver::parseAll task", "parse");
+			QFile file(path);
+			if (!file.open(QIODevice::ReadOnly)) {
+				return;
+			}
+			const auto contents = file.readAll();
+			file.close();
+			const auto hash = QCryptographicHash::hash(contents, QCryptographicHash::Md5);
+
+			ParsedInstancePtr parsed;
+			{
+				QMutexLocker lock(&this->parsedByHashMutex);
+				parsed = this->parsedByHash.value(hash);
+			}
+			if (!parsed) {
+				auto instance = std::make_shared<ParsedInstance>();
+				if (EntityKVParser parser{QString::fromUtf8(contents)}) {
+					instance->entities = parser.getEntities();
+					instance->instances = parser.getInstances();
+				}
+				parsed = instance;
+
+				QMutexLocker lock(&this->parsedByHashMutex);
+				this->parsedByHash.insert(hash, parsed);
+			}
+
+			QMutexLocker lock(&resultsMutex);
+			results.insert(path, parsed);
+		});
+	}
+	pool.waitForDone();
+	return results;
+}
+
+void InstanceResolver::expand(ExpandState& state, const QString& containingPath, const QList<EntityInstanceKV>& instances, const Fixup& parent) {
+	for (const auto& instance : instances) {
+		const auto path = resolveInstancePath(containingPath, instance.file);
+		const auto file = state.files.constFind(path);
+		if (path.isEmpty() || file == state.files.constEnd() || state.stack.contains(path) || state.stack.size() > MAX_DEPTH) {
+			continue;
+		}
+
+		// The instance's own name and variables are subject to the fixups of whatever placed it
+		Fixup fixup;
+		fixup.name = fixupName(applyReplacements(instance.targetname, parent.replacements), parent.name, parent.style);
+		if (fixup.name.isEmpty()) {
+			fixup.name = QString("AutoInstance%1").arg(state.nextAutoName++);
+		}
+		fixup.style = instance.fixupStyle;
+		fixup.replacements = instance.replacements;
+		for (auto& [variable, replacement] : fixup.replacements) {
+			replacement = applyReplacements(replacement, parent.replacements);
+		}
+		// Longest first, so $door doesn't eat the start of $door_name
+		std::sort(fixup.replacements.begin(), fixup.replacements.end(), [](const auto& lhs, const auto& rhs) {
+			return lhs.first.size() > rhs.first.size();
+		});
+		// The file as written rather than where it was found, so the key survives the map moving
+		fixup.key = parent.key + QDir::fromNativeSeparators(instance.file).toLower() + ':' + fixup.name.toLower() + '/';
+		state.instancesByName.insert(fixup.name.toLower(), fixup);
+
+		for (const auto& entity : (*file)->entities) {
+			EntityKV expanded;
+			expanded.id = state.nextId++;
+			expanded.instanceKey = fixup.key + QString::number(entity.id);
+			expanded.classname = applyReplacements(entity.classname, fixup.replacements);
+			expanded.targetname = fixupName(applyReplacements(entity.targetname, fixup.replacements), fixup.name, fixup.style);
+			expanded.connections.reserve(entity.connections.size());
+			for (const auto& connection : entity.connections) {
+				EntityConnectionKV expandedConnection;
+				expandedConnection.output = applyReplacements(connection.output, fixup.replacements);
+				expandedConnection.targetname = fixupName(applyReplacements(connection.targetname, fixup.replacements), fixup.name, fixup.style);
+				expandedConnection.input = applyReplacements(connection.input, fixup.replacements);
+				expandedConnection.parameter = applyReplacements(connection.parameter, fixup.replacements);
+				expandedConnection.delay = applyReplacements(connection.delay, fixup.replacements);
+				expandedConnection.fireAmount = connection.fireAmount;
+				expanded.connections.push_back(expandedConnection);
+			}
+			state.out.push_back(expanded);
+		}
+
+		state.stack.push_back(path);
+		this->expand(state, path, (*file)->instances, fixup);
+		state.stack.pop_back();
+	}
+}
+
+QString InstanceResolver::resolveInstancePath(const QString& containingPath, const QString& instanceFile) {
+	if (instanceFile.isEmpty()) {
+		return {};
+	}
+	auto relativePath = QDir::fromNativeSeparators(instanceFile);
+	if (QFileInfo(relativePath).suffix().isEmpty()) {
+		relativePath += ".vmf";
+	}
+	if (QFileInfo(relativePath).isAbsolute()) {
+		return QFileInfo::exists(relativePath) ? QFileInfo(relativePath).absoluteFilePath() : QString();
+	}
+
+	// Paths are usually relative to the VMF that placed the instance, but some games resolve them
+	// from a shared mapsrc folder further up, so walk up until something matches
+	QDir directory = QFileInfo(containingPath).absoluteDir();
+	do {
+		if (QFileInfo candidate{directory.filePath(relativePath)}; candidate.isFile()) {
+			return candidate.absoluteFilePath();
+		}
+	} while (directory.cdUp());
+	return {};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include "VMFWrapper.h"
+
+class MemoryReport;
+
+/// Expands func_instance entities into the entities of the VMFs they point to, recursively.
+/// Every level of nesting is parsed in parallel, and parsed files are kept around keyed by
+/// the hash of their contents, so a prefab placed hundreds of times is only parsed once.
+class InstanceResolver {
+public:
+	/// Returns the given entities followed by the entities of every instance they use, with names
+	/// fixed up and $variables replaced the same way VBSP does it
+	[[nodiscard]] QList<EntityKV> resolve(const QString& mapPath, const QList<EntityKV>& entities, const QList<EntityInstanceKV>& instances);
+
+	void clearCache();
+
+	/// Adds the cached parsed instances
+	void reportMemory(MemoryReport& report) const;
+
+	/// Deepest func_instance nesting that will be expanded
+	static constexpr int MAX_DEPTH = 16;
+
+private:
+	struct ParsedInstance {
+		QList<EntityKV> entities;
+		QList<EntityInstanceKV> instances;
+	};
+
+	using ParsedInstancePtr = std::shared_ptr<const ParsedInstance>;
+
+	struct Fixup {
+		QString name;
+		EntityInstanceKV::FixupStyle style;
+		QList<QPair<QString, QString>> replacements;
+		/// Prefix of EntityKV::instanceKey for everything inside this instance
+		QString key;
+	};
+
+	struct ExpandState {
+		QHash<QString, ParsedInstancePtr> files;
+		QHash<QString, Fixup> instancesByName;
+		QStringList stack;
+		QList<EntityKV> out;
+		int nextId;
+		int nextAutoName;
+	};
+
+	/// Parsed files, keyed by the hash of their contents
+	QHash<QByteArray, ParsedInstancePtr> parsedByHash;
+	mutable QMutex parsedByHashMutex;
+
+	/// Reads every path in parallel, parsing whatever isn't cached yet
+	QHash<QString, ParsedInstancePtr> parseAll(const QStringList& paths);
+
+	void expand(ExpandState& state, const QString& containingPath, const QList<EntityInstanceKV>& instances, const Fixup& parent);
+
+	/// Finds an instance's VMF relative to the file that placed it, or returns an empty string
+	[[nodiscard]] static QString resolveInstancePath(const QString& containingPath, const QString& instanceFile);
+};
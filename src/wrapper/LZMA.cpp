@@ -0,0 +1,314 @@
+#include "LZMA.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// A straightforward decoder following the reference LZMA specification. It only needs to handle
+// streams that decompress into a buffer we already know the size of, so the output buffer doubles
+// as the dictionary.
+
+namespace {
+
+using Prob = std::uint16_t;
+
+constexpr unsigned NUM_BIT_MODEL_TOTAL_BITS = 11;
+constexpr Prob PROB_INIT = (1 << NUM_BIT_MODEL_TOTAL_BITS) / 2;
+constexpr unsigned NUM_MOVE_BITS = 5;
+constexpr std::uint32_t TOP_VALUE = 1u << 24;
+
+constexpr unsigned NUM_STATES = 12;
+constexpr unsigned NUM_POS_BITS_MAX = 4;
+constexpr unsigned NUM_LEN_TO_POS_STATES = 4;
+constexpr unsigned NUM_ALIGN_BITS = 4;
+constexpr unsigned START_POS_MODEL_INDEX = 4;
+constexpr unsigned END_POS_MODEL_INDEX = 14;
+constexpr unsigned NUM_FULL_DISTANCES = 1 << (END_POS_MODEL_INDEX >> 1);
+constexpr unsigned MATCH_MIN_LEN = 2;
+
+class RangeDecoder {
+public:
+	RangeDecoder(const std::uint8_t* in_, std::size_t inSize_)
+			: in(in_)
+			, inSize(inSize_) {}
+
+	bool init() {
+		const auto first = this->nextByte();
+		for (int i = 0; i < 4; i++) {
+			this->code = (this->code << 8) | this->nextByte();
+		}
+		return first == 0 && this->code != this->range && !this->corrupted;
+	}
+
+	[[nodiscard]] bool isCorrupted() const {
+		return this->corrupted;
+	}
+
+	std::uint32_t decodeDirectBits(unsigned numBits) {
+		std::uint32_t result = 0;
+		do {
+			this->range >>= 1;
+			this->code -= this->range;
+			const std::uint32_t t = 0 - (this->code >> 31);
+			this->code += this->range & t;
+			if (this->code == this->range) {
+				this->corrupted = true;
+			}
+			this->normalize();
+			result <<= 1;
+			result += t + 1;
+		} while (--numBits);
+		return result;
+	}
+
+	unsigned decodeBit(Prob* prob) {
+		unsigned v = *prob;
+		const std::uint32_t bound = (this->range >> NUM_BIT_MODEL_TOTAL_BITS) * v;
+		unsigned symbol;
+		if (this->code < bound) {
+			v += ((1 << NUM_BIT_MODEL_TOTAL_BITS) - v) >> NUM_MOVE_BITS;
+			this->range = bound;
+			symbol = 0;
+		} else {
+			v -= v >> NUM_MOVE_BITS;
+			this->code -= bound;
+			this->range -= bound;
+			symbol = 1;
+		}
+		*prob = static_cast<Prob>(v);
+		this->normalize();
+		return symbol;
+	}
+
+private:
+	const std::uint8_t* in;
+	std::size_t inSize;
+	std::size_t pos = 0;
+	std::uint32_t range = 0xFFFFFFFF;
+	std::uint32_t code = 0;
+	bool corrupted = false;
+
+	std::uint8_t nextByte() {
+		if (this->pos < this->inSize) {
+			return this->in[this->pos++];
+		}
+		this->corrupted = true;
+		return 0;
+	}
+
+	void normalize() {
+		if (this->range < TOP_VALUE) {
+			this->range <<= 8;
+			this->code = (this->code << 8) | this->nextByte();
+		}
+	}
+};
+
+unsigned bitTreeReverseDecode(Prob* probs, unsigned numBits, RangeDecoder& rc) {
+	unsigned m = 1;
+	unsigned symbol = 0;
+	for (unsigned i = 0; i < numBits; i++) {
+		const unsigned bit = rc.decodeBit(&probs[m]);
+		m <<= 1;
+		m += bit;
+		symbol |= bit << i;
+	}
+	return symbol;
+}
+
+template<unsigned NumBits>
+struct BitTreeDecoder {
+	std::array<Prob, 1 << NumBits> probs;
+
+	BitTreeDecoder() {
+		this->probs.fill(PROB_INIT);
+	}
+
+	unsigned decode(RangeDecoder& rc) {
+		unsigned m = 1;
+		for (unsigned i = 0; i < NumBits; i++) {
+			m = (m << 1) + rc.decodeBit(&this->probs[m]);
+		}
+		return m - (1u << NumBits);
+	}
+
+	unsigned reverseDecode(RangeDecoder& rc) {
+		return bitTreeReverseDecode(this->probs.data(), NumBits, rc);
+	}
+};
+
+struct LenDecoder {
+	Prob choice = PROB_INIT;
+	Prob choice2 = PROB_INIT;
+	std::array<BitTreeDecoder<3>, 1 << NUM_POS_BITS_MAX> lowCoder;
+	std::array<BitTreeDecoder<3>, 1 << NUM_POS_BITS_MAX> midCoder;
+	BitTreeDecoder<8> highCoder;
+
+	unsigned decode(RangeDecoder& rc, unsigned posState) {
+		if (!rc.decodeBit(&this->choice)) {
+			return this->lowCoder[posState].decode(rc);
+		}
+		if (!rc.decodeBit(&this->choice2)) {
+			return 8 + this->midCoder[posState].decode(rc);
+		}
+		return 16 + this->highCoder.decode(rc);
+	}
+};
+
+template<std::size_t N>
+std::array<Prob, N> makeProbs() {
+	std::array<Prob, N> probs;
+	probs.fill(PROB_INIT);
+	return probs;
+}
+
+} // namespace
+
+bool LZMA::decompress(const std::uint8_t* properties, const std::uint8_t* in, std::size_t inSize, std::uint8_t* out, std::size_t outSize) {
+	unsigned d = properties[0];
+	if (d >= 9 * 5 * 5) {
+		return false;
+	}
+	const unsigned lc = d % 9;
+	d /= 9;
+	const unsigned lp = d % 5;
+	const unsigned pb = d / 5;
+	std::uint32_t dictSize = 0;
+	for (int i = 0; i < 4; i++) {
+		dictSize |= static_cast<std::uint32_t>(properties[1 + i]) << (8 * i);
+	}
+	dictSize = std::max<std::uint32_t>(dictSize, 1 << 12);
+
+	RangeDecoder rc{in, inSize};
+	if (!rc.init()) {
+		return false;
+	}
+
+	std::vector<Prob> literalProbs(static_cast<std::size_t>(0x300) << (lc + lp), PROB_INIT);
+	std::array<BitTreeDecoder<6>, NUM_LEN_TO_POS_STATES> posSlotDecoder;
+	BitTreeDecoder<NUM_ALIGN_BITS> alignDecoder;
+	auto posDecoders = makeProbs<1 + NUM_FULL_DISTANCES - END_POS_MODEL_INDEX>();
+	auto isMatch = makeProbs<NUM_STATES << NUM_POS_BITS_MAX>();
+	auto isRep = makeProbs<NUM_STATES>();
+	auto isRepG0 = makeProbs<NUM_STATES>();
+	auto isRepG1 = makeProbs<NUM_STATES>();
+	auto isRepG2 = makeProbs<NUM_STATES>();
+	auto isRep0Long = makeProbs<NUM_STATES << NUM_POS_BITS_MAX>();
+	LenDecoder lenDecoder;
+	LenDecoder repLenDecoder;
+
+	std::size_t pos = 0;
+	std::uint32_t rep0 = 0, rep1 = 0, rep2 = 0, rep3 = 0;
+	unsigned state = 0;
+
+	while (pos < outSize) {
+		if (rc.isCorrupted()) {
+			return false;
+		}
+		const unsigned posState = pos & ((1u << pb) - 1);
+
+		if (!rc.decodeBit(&isMatch[(state << NUM_POS_BITS_MAX) + posState])) {
+			// Literal
+			const unsigned prevByte = pos > 0 ? out[pos - 1] : 0;
+			const unsigned litState = ((pos & ((1u << lp) - 1)) << lc) + (prevByte >> (8 - lc));
+			Prob* probs = &literalProbs[static_cast<std::size_t>(0x300) * litState];
+			unsigned symbol = 1;
+			if (state >= 7) {
+				if (rep0 >= pos) {
+					return false;
+				}
+				unsigned matchByte = out[pos - rep0 - 1];
+				do {
+					const unsigned matchBit = (matchByte >> 7) & 1;
+					matchByte <<= 1;
+					const unsigned bit = rc.decodeBit(&probs[((1 + matchBit) << 8) + symbol]);
+					symbol = (symbol << 1) | bit;
+					if (matchBit != bit) {
+						break;
+					}
+				} while (symbol < 0x100);
+			}
+			while (symbol < 0x100) {
+				symbol = (symbol << 1) | rc.decodeBit(&probs[symbol]);
+			}
+			out[pos++] = static_cast<std::uint8_t>(symbol - 0x100);
+			state = state < 4 ? 0 : (state < 10 ? state - 3 : state - 6);
+			continue;
+		}
+
+		unsigned len;
+		if (rc.decodeBit(&isRep[state])) {
+			if (pos == 0) {
+				return false;
+			}
+			if (!rc.decodeBit(&isRepG0[state])) {
+				if (!rc.decodeBit(&isRep0Long[(state << NUM_POS_BITS_MAX) + posState])) {
+					// Short rep, a single byte
+					if (rep0 >= pos) {
+						return false;
+					}
+					state = state < 7 ? 9 : 11;
+					out[pos] = out[pos - rep0 - 1];
+					pos++;
+					continue;
+				}
+			} else {
+				std::uint32_t dist;
+				if (!rc.decodeBit(&isRepG1[state])) {
+					dist = rep1;
+				} else {
+					if (!rc.decodeBit(&isRepG2[state])) {
+						dist = rep2;
+					} else {
+						dist = rep3;
+						rep3 = rep2;
+					}
+					rep2 = rep1;
+				}
+				rep1 = rep0;
+				rep0 = dist;
+			}
+			len = repLenDecoder.decode(rc, posState);
+			state = state < 7 ? 8 : 11;
+		} else {
+			rep3 = rep2;
+			rep2 = rep1;
+			rep1 = rep0;
+			len = lenDecoder.decode(rc, posState);
+			state = state < 7 ? 7 : 10;
+
+			// Distance
+			const unsigned lenState = len < NUM_LEN_TO_POS_STATES - 1 ? len : NUM_LEN_TO_POS_STATES - 1;
+			const unsigned posSlot = posSlotDecoder[lenState].decode(rc);
+			if (posSlot < START_POS_MODEL_INDEX) {
+				rep0 = posSlot;
+			} else {
+				const unsigned numDirectBits = (posSlot >> 1) - 1;
+				std::uint32_t dist = (2 | (posSlot & 1)) << numDirectBits;
+				if (posSlot < END_POS_MODEL_INDEX) {
+					dist += bitTreeReverseDecode(posDecoders.data() + dist - posSlot, numDirectBits, rc);
+				} else {
+					dist += rc.decodeDirectBits(numDirectBits - NUM_ALIGN_BITS) << NUM_ALIGN_BITS;
+					dist += alignDecoder.reverseDecode(rc);
+				}
+				rep0 = dist;
+			}
+			if (rep0 == 0xFFFFFFFF) {
+				// End marker before we got everything we were promised
+				return false;
+			}
+			if (rep0 >= dictSize || rep0 >= pos) {
+				return false;
+			}
+		}
+
+		len += MATCH_MIN_LEN;
+		if (rep0 >= pos || len > outSize - pos) {
+			return false;
+		}
+		for (unsigned i = 0; i < len; i++, pos++) {
+			out[pos] = out[pos - rep0 - 1];
+		}
+	}
+	return !rc.isCorrupted();
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace LZMA {
+
+/// Size of the 5 byte LZMA properties block (lc/lp/pb and dictionary size)
+constexpr std::size_t PROPERTIES_SIZE = 5;
+
+/// Decodes a raw LZMA stream into exactly outSize bytes. Returns false if the stream is corrupt or too short
+bool decompress(const std::uint8_t* properties, const std::uint8_t* in, std::size_t inSize, std::uint8_t* out, std::size_t outSize);
+
+} // namespace LZMA
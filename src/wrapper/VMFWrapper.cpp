@@ -1,10 +1,86 @@
 #include "VMFWrapper.h"
 
+#include <charconv>
+#include <optional>
+#include <string_view>
+
 // I made the library I'm allowed to do this
 #include <vmfpp/detail/StringUtils.h>
 #include <vmfpp/Reader.h>
 
+#include "../debug/MemoryReport.h"
+#include "../debug/Trace.h"
+
+namespace {
+
+/// The first value of the key, or nullptr if the node doesn't have one
+const std::string* firstValue(const vmfpp::Node& node, const char* key) {
+	if (!node.hasValue(key) || node.getValue(key).empty()) {
+		return nullptr;
+	}
+	return &node.getValue(key).front();
+}
+
+/// Unlike std::stoi, this doesn't throw when the map has something that isn't a number
+std::optional<int> toInt(std::string_view str) {
+	int out;
+	if (std::from_chars(str.data(), str.data() + str.size(), out).ec != std::errc{}) {
+		return std::nullopt;
+	}
+	return out;
+}
+
+/// The first value of the key as an integer, or the fallback if it's missing or isn't one
+int intValue(const vmfpp::Node& node, const char* key, int fallback) {
+	const auto* value = firstValue(node, key);
+	return value ? toInt(*value).value_or(fallback) : fallback;
+}
+
+/// Everything a node owns, but not the node object itself
+qint64 nodeMemoryUsage(const vmfpp::Node& node) {
+	qint64 bytes = MemoryUsage::heapOfNodes(node.getValues());
+	for (const auto& [key, values] : node.getValues()) {
+		bytes += MemoryUsage::heap(key) + MemoryUsage::heap(values);
+		for (const auto& value : values) {
+			bytes += MemoryUsage::heap(value);
+		}
+	}
+	bytes += MemoryUsage::heapOfNodes(node.getChildren());
+	for (const auto& [key, children] : node.getChildren()) {
+		bytes += MemoryUsage::heap(key) + MemoryUsage::heap(children);
+		for (const auto& child : children) {
+			bytes += nodeMemoryUsage(child);
+		}
+	}
+	return bytes;
+}
+
+} // namespace
+
+qint64 entityMemoryUsage(const QList<EntityKV>& entities) {
+	qint64 bytes = MemoryUsage::heap(entities);
+	for (const auto& entity : entities) {
+		bytes += MemoryUsage::heap(entity.classname) + MemoryUsage::heap(entity.targetname) + MemoryUsage::heap(entity.connections) + MemoryUsage::heap(entity.instanceKey);
+		for (const auto& connection : entity.connections) {
+			bytes += MemoryUsage::heap(connection.output) + MemoryUsage::heap(connection.targetname) + MemoryUsage::heap(connection.input) + MemoryUsage::heap(connection.parameter) + MemoryUsage::heap(connection.delay);
+		}
+	}
+	return bytes;
+}
+
+qint64 instanceMemoryUsage(const QList<EntityInstanceKV>& instances) {
+	qint64 bytes = MemoryUsage::heap(instances);
+	for (const auto& instance : instances) {
+		bytes += MemoryUsage::heap(instance.targetname) + MemoryUsage::heap(instance.file) + MemoryUsage::heap(instance.replacements);
+		for (const auto& [variable, value] : instance.replacements) {
+			bytes += MemoryUsage::heap(variable) + MemoryUsage::heap(value);
+		}
+	}
+	return bytes;
+}
+
 EntityKVParser::EntityKVParser(const QString& contents) {
+	ENTGRAPH_TRACE_SCOPE("vmfpp::Reader::readData", "parse");
 	vmfpp::Reader reader;
 	this->valid = reader.readData(this->root, contents.toStdString());
 }
@@ -18,16 +94,29 @@ EntityKVParser::operator bool() const {
 }
 
 QList<EntityKV> EntityKVParser::getEntities() const {
+	ENTGRAPH_TRACE_SCOPE("EntityKVParser::getEntities", "parse");
 	QList<EntityKV> entities;
 	if (!this->valid || !this->root.hasSection(vmfpp::DEFAULT_SECTIONS::ENTITY)) {
 		return entities;
 	}
+	// This also runs on instance VMFs on worker threads, where an exception would take the whole program down,
+	// so anything malformed is skipped instead of thrown over
 	const auto& entitySection = this->root.getSection(vmfpp::DEFAULT_SECTIONS::ENTITY);
 	for (const auto& entity : entitySection) {
+		const auto* id = firstValue(entity, "id");
+		const auto* classname = firstValue(entity, "classname");
+		if (!id || !classname) {
+			continue;
+		}
+		const auto parsedId = toInt(*id);
+		if (!parsedId) {
+			continue;
+		}
 		EntityKV entData;
-		entData.id = std::stoi(entity.getValue("id").at(0));
-		entData.classname = entity.getValue("classname").at(0).data();
-		entData.targetname = entity.hasValue("targetname") ? entity.getValue("targetname").at(0).data() : "";
+		entData.id = *parsedId;
+		entData.classname = classname->data();
+		const auto* targetname = firstValue(entity, "targetname");
+		entData.targetname = targetname ? targetname->data() : "";
 		if (entity.hasChild("connections")) {
 			for (const auto& connection : entity.getChild("connections")) {
 				for (const auto& [connectionOutput, connectionInfos] : connection.getValues()) {
@@ -40,11 +129,18 @@ QList<EntityKV> EntityKVParser::getEntities() const {
 						} else {
 							infoParts = vmfpp::detail::split(connectionInfo, ',');
 						}
+						if (infoParts.size() < 5) {
+							continue;
+						}
+						const auto fireAmount = toInt(infoParts[4]);
+						if (!fireAmount) {
+							continue;
+						}
 						entConnectionData.targetname = infoParts[0].c_str();
 						entConnectionData.input = infoParts[1].c_str();
 						entConnectionData.parameter = infoParts[2].c_str();
 						entConnectionData.delay = infoParts[3].c_str();
-						entConnectionData.fireAmount = std::stoi(infoParts[4]);
+						entConnectionData.fireAmount = *fireAmount;
 						entData.connections.push_back(entConnectionData);
 					}
 				}
@@ -54,3 +150,55 @@ QList<EntityKV> EntityKVParser::getEntities() const {
 	}
 	return entities;
 }
+
+QList<EntityInstanceKV> EntityKVParser::getInstances() const {
+	ENTGRAPH_TRACE_SCOPE("EntityKVParser::getInstances", "parse");
+	QList<EntityInstanceKV> instances;
+	if (!this->valid || !this->root.hasSection(vmfpp::DEFAULT_SECTIONS::ENTITY)) {
+		return instances;
+	}
+	const auto& entitySection = this->root.getSection(vmfpp::DEFAULT_SECTIONS::ENTITY);
+	for (const auto& entity : entitySection) {
+		const auto* classname = firstValue(entity, "classname");
+		const auto* file = firstValue(entity, "file");
+		if (!classname || *classname != "func_instance" || !file) {
+			continue;
+		}
+		EntityInstanceKV instData;
+		instData.id = intValue(entity, "id", 0);
+		const auto* targetname = firstValue(entity, "targetname");
+		instData.targetname = targetname ? targetname->data() : "";
+		instData.file = file->data();
+		// Anything missing, malformed, or out of range falls back to prefixing like Hammer does
+		instData.fixupStyle = EntityInstanceKV::FIXUP_PREFIX;
+		if (const auto fixupStyle = intValue(entity, "fixup_style", EntityInstanceKV::FIXUP_PREFIX); fixupStyle == EntityInstanceKV::FIXUP_POSTFIX || fixupStyle == EntityInstanceKV::FIXUP_NONE) {
+			instData.fixupStyle = static_cast<EntityInstanceKV::FixupStyle>(fixupStyle);
+		}
+		for (const auto& [key, values] : entity.getValues()) {
+			// replace01, replace02, ... hold "$variable value"
+			if (!key.starts_with("replace") || values.empty()) {
+				continue;
+			}
+			const auto replacement = QString::fromStdString(values.at(0));
+			const auto split = replacement.indexOf(' ');
+			if (!replacement.startsWith('$') || split < 0) {
+				continue;
+			}
+			instData.replacements.push_back({replacement.left(split), replacement.mid(split + 1)});
+		}
+		instances.push_back(instData);
+	}
+	return instances;
+}
+
+qint64 EntityKVParser::memoryUsage() const {
+	ENTGRAPH_TRACE_SCOPE("EntityKVParser::memoryUsage", "debug");
+	qint64 bytes = MemoryUsage::heapOfNodes(this->root.getSections());
+	for (const auto& [name, nodes] : this->root.getSections()) {
+		bytes += MemoryUsage::heap(name) + MemoryUsage::heap(nodes);
+		for (const auto& node : nodes) {
+			bytes += nodeMemoryUsage(node);
+		}
+	}
+	return bytes;
+}
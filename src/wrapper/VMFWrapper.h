@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QList>
+#include <QPair>
 #include <QString>
 
 #include <vmfpp/VMF.h>
@@ -19,8 +20,32 @@ struct EntityKV {
 	QString classname;
 	QString targetname;
 	QList<EntityConnectionKV> connections;
+	/// Empty for entities the map has itself. Entities expanded from an instance get new ids every time,
+	/// so this identifies them instead: the chain of instance files and names, then the id inside the instance
+	QString instanceKey;
 };
 
+struct EntityInstanceKV {
+	enum FixupStyle {
+		FIXUP_PREFIX = 0,
+		FIXUP_POSTFIX = 1,
+		FIXUP_NONE = 2,
+	};
+
+	int id;
+	QString targetname;
+	QString file;
+	FixupStyle fixupStyle;
+	/// $variable and the value to replace it with
+	QList<QPair<QString, QString>> replacements;
+};
+
+/// Approximate heap bytes held by a list of entities and their connections
+[[nodiscard]] qint64 entityMemoryUsage(const QList<EntityKV>& entities);
+
+/// Approximate heap bytes held by a list of instances
+[[nodiscard]] qint64 instanceMemoryUsage(const QList<EntityInstanceKV>& instances);
+
 class EntityKVParser {
 public:
 	explicit EntityKVParser(const QString& contents);
@@ -31,6 +56,12 @@ public:
 
 	[[nodiscard]] QList<EntityKV> getEntities() const;
 
+	/// The func_instance entities in the map, with what's needed to expand them
+	[[nodiscard]] QList<EntityInstanceKV> getInstances() const;
+
+	/// Approximate heap bytes held by the parsed tree. Walks the whole tree, so it's as slow as reading it
+	[[nodiscard]] qint64 memoryUsage() const;
+
 private:
 	vmfpp::Root root;
 	bool valid;